@@ -0,0 +1,754 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "channel.h"
+#include "trace.h"
+#include "histogram.h"
+
+// Throughput benchmarks for the channel backends
+// Usage: ./channel_bench [benchmark] [max_threads]
+
+#define NS_PER_SEC 1000000000ull
+#define BENCH_CAPACITY 1024
+#define BENCH_MESSAGES 2000000
+
+#define BENCH_BATCH 64
+#define BENCH_ROUNDS 100000
+#define BENCH_ROUTES 16
+#define BENCH_INPUTS 4
+#define BENCH_HOT_SHARE 8
+#define BENCH_FANOUT 4
+#define BENCH_NODES 50000                           // Channels in the arena benchmark
+#define BENCH_RECORD_WORDS 4                       // 32-byte records for the typed benchmark
+#define BENCH_EVENTS 10000000                       // trace_record calls in the trace benchmark
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+} bench_args;
+
+uint64_t bench_time()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+void* bench_producer(bench_args* myargs)
+{
+    for (size_t i = 1; i <= myargs->count; i++) {
+        enum channel_status status = channel_send(myargs->channel, (void*)i);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    return NULL;
+}
+
+void* bench_consumer(bench_args* myargs)
+{
+    for (size_t i = 0; i < myargs->count; i++) {
+        void* data;
+        enum channel_status status = channel_receive(myargs->channel, &data);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    return NULL;
+}
+
+// Runs `pairs` producers and `pairs` consumers over one channel and returns millions of messages per second
+double run_fan(channel_t* channel, size_t pairs, size_t messages)
+{
+    pthread_t producers[pairs], consumers[pairs];
+    bench_args args = {channel, messages / pairs};
+    uint64_t start = bench_time();
+    for (size_t i = 0; i < pairs; i++) {
+        pthread_create(&consumers[i], NULL, (void*)bench_consumer, &args);
+        pthread_create(&producers[i], NULL, (void*)bench_producer, &args);
+    }
+    for (size_t i = 0; i < pairs; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    uint64_t elapsed = bench_time() - start;
+    channel_close(channel);
+    channel_destroy(channel);
+    return (double)(args.count * pairs) * 1000.0 / (double)elapsed;
+}
+
+void* bench_batch_producer(bench_args* myargs)
+{
+    void* items[BENCH_BATCH];
+    for (size_t i = 0; i < BENCH_BATCH; i++) {
+        items[i] = (void*)(i + 1);
+    }
+    size_t remaining = myargs->count;
+    while (remaining > 0) {
+        size_t sent;
+        enum channel_status status = channel_send_batch(myargs->channel, items, remaining < BENCH_BATCH ? remaining : BENCH_BATCH, &sent);
+        assert(status == SUCCESS);
+        (void)status;
+        remaining -= sent;
+    }
+    return NULL;
+}
+
+void* bench_batch_consumer(bench_args* myargs)
+{
+    void* items[BENCH_BATCH];
+    size_t remaining = myargs->count;
+    while (remaining > 0) {
+        size_t received;
+        enum channel_status status = channel_receive_batch(myargs->channel, items, remaining < BENCH_BATCH ? remaining : BENCH_BATCH, &received);
+        assert(status == SUCCESS);
+        (void)status;
+        remaining -= received;
+    }
+    return NULL;
+}
+
+void bench_batch(size_t max_threads)
+{
+    (void)max_threads;
+    printf("batch: one producer, one consumer, capacity %d, batches of %d (Mmsg/s)\n", BENCH_CAPACITY, BENCH_BATCH);
+    printf("%10s %10s\n", "single", "batch");
+    double single = run_fan(channel_create(BENCH_CAPACITY), 1, BENCH_MESSAGES);
+    channel_t* channel = channel_create(BENCH_CAPACITY);
+    pthread_t producer, consumer;
+    bench_args args = {channel, BENCH_MESSAGES};
+    uint64_t start = bench_time();
+    pthread_create(&consumer, NULL, (void*)bench_batch_consumer, &args);
+    pthread_create(&producer, NULL, (void*)bench_batch_producer, &args);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    uint64_t elapsed = bench_time() - start;
+    channel_close(channel);
+    channel_destroy(channel);
+    printf("%10.2f %10.2f\n", single, (double)BENCH_MESSAGES * 1000.0 / (double)elapsed);
+}
+
+void bench_spsc(size_t max_threads)
+{
+    (void)max_threads;
+    printf("spsc: one producer, one consumer, capacity %d (Mmsg/s)\n", BENCH_CAPACITY);
+    printf("%10s %10s\n", "mutex", "spsc");
+    double locked = run_fan(channel_create(BENCH_CAPACITY), 1, BENCH_MESSAGES);
+    double spsc = run_fan(channel_create_spsc(BENCH_CAPACITY), 1, BENCH_MESSAGES);
+    printf("%10.2f %10.2f\n", locked, spsc);
+}
+
+void bench_mpmc(size_t max_threads)
+{
+    printf("mpmc: N producers, N consumers, capacity %d (Mmsg/s)\n", BENCH_CAPACITY);
+    printf("%8s %10s %10s\n", "threads", "mutex", "mpmc");
+    for (size_t pairs = 1; 2 * pairs <= max_threads; pairs *= 2) {
+        double locked = run_fan(channel_create(BENCH_CAPACITY), pairs, BENCH_MESSAGES);
+        double mpmc = run_fan(channel_create_mpmc(BENCH_CAPACITY), pairs, BENCH_MESSAGES);
+        printf("%8zu %10.2f %10.2f\n", 2 * pairs, locked, mpmc);
+    }
+}
+
+typedef struct {
+    channel_t* ping;
+    channel_t* pong;
+} pingpong_args;
+
+void* bench_ponger(pingpong_args* myargs)
+{
+    void* data;
+    while (channel_receive(myargs->ping, &data) == SUCCESS) {
+        if (channel_send(myargs->pong, data) != SUCCESS) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Bounces one message between two threads over a pair of channels created from attr
+// Stores the median and 99th percentile round trip in nanoseconds
+void run_pingpong(channel_attr_t attr, uint64_t* p50, uint64_t* p99)
+{
+    pingpong_args args = {channel_create_with_attr(&attr), channel_create_with_attr(&attr)};
+    uint64_t* rounds = malloc(BENCH_ROUNDS * sizeof(uint64_t));
+    pthread_t ponger;
+    pthread_create(&ponger, NULL, (void*)bench_ponger, &args);
+    for (size_t i = 0; i < BENCH_ROUNDS; i++) {
+        void* data;
+        uint64_t start = bench_time();
+        channel_send(args.ping, (void*)(i + 1));
+        channel_receive(args.pong, &data);
+        rounds[i] = bench_time() - start;
+    }
+    channel_close(args.ping);
+    pthread_join(ponger, NULL);
+    channel_destroy(args.ping);
+    channel_destroy(args.pong);
+    qsort(rounds, BENCH_ROUNDS, sizeof(uint64_t), compare_u64);
+    *p50 = rounds[BENCH_ROUNDS / 2];
+    *p99 = rounds[BENCH_ROUNDS * 99 / 100];
+    free(rounds);
+}
+
+void bench_pingpong(size_t max_threads)
+{
+    (void)max_threads;
+    printf("pingpong: round trip between two threads, %d rounds (ns)\n", BENCH_ROUNDS);
+    printf("%12s %10s %10s %10s %10s\n", "channel", "cond p50", "cond p99", "futex p50", "futex p99");
+    channel_attr_t attrs[] = {{CHANNEL_LOCKED, 1, CHANNEL_PARK_COND},
+                              {CHANNEL_SPSC, 1, CHANNEL_PARK_COND},
+                              {CHANNEL_UNBUFFERED, 0, CHANNEL_PARK_COND}};
+    char* names[] = {"mutex", "spsc", "unbuffered"};
+    for (size_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+        uint64_t cond50, cond99, futex50, futex99;
+        run_pingpong(attrs[i], &cond50, &cond99);
+        attrs[i].park = CHANNEL_PARK_FUTEX;
+        run_pingpong(attrs[i], &futex50, &futex99);
+        printf("%12s %10lu %10lu %10lu %10lu\n", names[i], cond50, cond99, futex50, futex99);
+    }
+}
+
+void bench_wait(size_t max_threads)
+{
+    (void)max_threads;
+    printf("wait: round trip between two threads per wait policy, %d rounds (ns)\n", BENCH_ROUNDS);
+    printf("%12s %10s %10s %10s %10s %10s %10s\n", "channel", "block p50", "block p99", "spin p50", "spin p99", "poll p50", "poll p99");
+    channel_attr_t attrs[] = {{CHANNEL_LOCKED, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_SPSC, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK}};
+    char* names[] = {"mutex", "spsc"};
+    for (size_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+        uint64_t p50[3], p99[3];
+        for (enum channel_wait wait = CHANNEL_WAIT_BLOCK; wait <= CHANNEL_WAIT_POLL; wait++) {
+            attrs[i].wait = wait;
+            run_pingpong(attrs[i], &p50[wait], &p99[wait]);
+        }
+        printf("%12s %10lu %10lu %10lu %10lu %10lu %10lu\n", names[i], p50[0], p99[0], p50[1], p99[1], p50[2], p99[2]);
+    }
+}
+
+typedef struct {
+    channel_t** channels;
+    size_t count;
+} route_args;
+
+void* bench_route_producer(route_args* myargs)
+{
+    for (size_t i = 1; i <= myargs->count; i++) {
+        channel_send(myargs->channels[i % BENCH_ROUTES], (void*)i);
+    }
+    return NULL;
+}
+
+// One router receives from BENCH_ROUTES channels through select; returns millions of messages per second
+double run_router(bool use_set, size_t messages)
+{
+    channel_t* channels[BENCH_ROUTES];
+    select_t list[BENCH_ROUTES];
+    select_set_t* set = use_set ? select_set_create() : NULL;
+    for (size_t i = 0; i < BENCH_ROUTES; i++) {
+        channels[i] = channel_create(1);
+        list[i] = (select_t) {channels[i], RECV, NULL};
+        if (set) {
+            select_set_add(set, &list[i]);
+        }
+    }
+    route_args args = {channels, messages};
+    pthread_t producer;
+    uint64_t start = bench_time();
+    pthread_create(&producer, NULL, (void*)bench_route_producer, &args);
+    for (size_t i = 0; i < messages; i++) {
+        size_t index;
+        select_t* selected;
+        enum channel_status status = set ? select_set_wait(set, &selected) : channel_select(list, BENCH_ROUTES, &index);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    pthread_join(producer, NULL);
+    uint64_t elapsed = bench_time() - start;
+    if (set) {
+        select_set_destroy(set);
+    }
+    for (size_t i = 0; i < BENCH_ROUTES; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return (double)messages * 1000.0 / (double)elapsed;
+}
+
+void bench_router(size_t max_threads)
+{
+    (void)max_threads;
+    printf("router: one producer, one router selecting over %d channels (Mmsg/s)\n", BENCH_ROUTES);
+    printf("%10s %10s\n", "select", "set");
+    double per_call = run_router(false, BENCH_MESSAGES / 10);
+    double set = run_router(true, BENCH_MESSAGES / 10);
+    printf("%10.2f %10.2f\n", per_call, set);
+}
+
+typedef struct {
+    channel_t* channel;
+    size_t count;
+} skew_args;
+
+void* bench_stamp_producer(skew_args* myargs)
+{
+    for (size_t i = 0; i < myargs->count; i++) {
+        channel_send(myargs->channel, (void*)(uintptr_t)bench_time());    // Latency counts from the attempt to send
+    }
+    return NULL;
+}
+
+// One router drains BENCH_INPUTS channels through a select set with the given order, while input 0
+// gets BENCH_HOT_SHARE times as many messages as each of the others
+// Stores the median and 99th percentile latency of each input in nanoseconds; returns millions of messages per second
+double run_skewed(enum select_order order, size_t cold, uint64_t p50[BENCH_INPUTS], uint64_t p99[BENCH_INPUTS])
+{
+    channel_t* channels[BENCH_INPUTS];
+    select_t list[BENCH_INPUTS];
+    skew_args args[BENCH_INPUTS];
+    uint64_t* latencies[BENCH_INPUTS];
+    size_t received[BENCH_INPUTS] = {0};
+    pthread_t producers[BENCH_INPUTS];
+    size_t messages = 0;
+    select_set_t* set = select_set_create();
+    select_set_order(set, order);
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        channels[i] = channel_create(BENCH_BATCH);
+        list[i] = (select_t) {channels[i], RECV, NULL};
+        select_set_add(set, &list[i]);
+        args[i] = (skew_args) {channels[i], i == 0 ? cold * BENCH_HOT_SHARE : cold};
+        latencies[i] = malloc(args[i].count * sizeof(uint64_t));
+        messages += args[i].count;
+    }
+    uint64_t start = bench_time();
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        pthread_create(&producers[i], NULL, (void*)bench_stamp_producer, &args[i]);
+    }
+    for (size_t n = 0; n < messages; n++) {
+        select_t* selected;
+        enum channel_status status = select_set_wait(set, &selected);
+        assert(status == SUCCESS);
+        (void)status;
+        size_t input = (size_t)(selected - list);
+        latencies[input][received[input]++] = bench_time() - (uint64_t)(uintptr_t)selected->data;
+    }
+    uint64_t elapsed = bench_time() - start;
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        pthread_join(producers[i], NULL);
+        qsort(latencies[i], args[i].count, sizeof(uint64_t), compare_u64);
+        p50[i] = latencies[i][args[i].count / 2];
+        p99[i] = latencies[i][args[i].count * 99 / 100];
+        free(latencies[i]);
+    }
+    select_set_destroy(set);
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return (double)messages * 1000.0 / (double)elapsed;
+}
+
+void bench_fair(size_t max_threads)
+{
+    (void)max_threads;
+    printf("fair: router over %d inputs, input 0 sends %dx as much as the others; latency per input (us)\n", BENCH_INPUTS, BENCH_HOT_SHARE);
+    printf("%12s", "order");
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        printf("    in%zu p50    in%zu p99", i, i);
+    }
+    printf(" %10s\n", "Mmsg/s");
+    char* names[] = {"in order", "random", "round robin"};
+    for (enum select_order order = SELECT_IN_ORDER; order <= SELECT_ROUND_ROBIN; order++) {
+        uint64_t p50[BENCH_INPUTS], p99[BENCH_INPUTS];
+        double rate = run_skewed(order, BENCH_ROUNDS / 4, p50, p99);
+        printf("%12s", names[order]);
+        for (size_t i = 0; i < BENCH_INPUTS; i++) {
+            printf(" %10.1f %10.1f", (double)p50[i] / 1000.0, (double)p99[i] / 1000.0);
+        }
+        printf(" %10.2f\n", rate);
+    }
+}
+
+typedef struct {
+    channel_t** channels;
+    broadcast_t* broadcast;
+    size_t count;
+} fanout_args;
+
+void* bench_fanout_producer(fanout_args* myargs)
+{
+    for (size_t i = 1; i <= myargs->count; i++) {
+        if (myargs->broadcast) {
+            broadcast_send(myargs->broadcast, (void*)i);                // One write for every reader
+        } else {
+            for (size_t k = 0; k < BENCH_FANOUT; k++) {
+                channel_send(myargs->channels[k], (void*)i);          // One lock and one copy per reader
+            }
+        }
+    }
+    return NULL;
+}
+
+void* bench_cursor_consumer(broadcast_cursor_t* cursor)
+{
+    for (size_t i = 0; i < BENCH_MESSAGES / BENCH_FANOUT; i++) {
+        void* data;
+        enum channel_status status = broadcast_receive(cursor, &data);
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    return NULL;
+}
+
+// One producer hands every message to BENCH_FANOUT consumers, through one channel per consumer
+// or through a broadcast; returns millions of messages sent per second
+double run_fanout(bool broadcast)
+{
+    size_t count = BENCH_MESSAGES / BENCH_FANOUT;
+    channel_t* channels[BENCH_FANOUT];
+    bench_args args[BENCH_FANOUT];
+    broadcast_cursor_t* cursors[BENCH_FANOUT];
+    pthread_t producer, consumers[BENCH_FANOUT];
+    fanout_args fargs = {channels, broadcast ? broadcast_create(BENCH_CAPACITY) : NULL, count};
+    for (size_t k = 0; k < BENCH_FANOUT; k++) {
+        if (broadcast) {
+            cursors[k] = broadcast_subscribe(fargs.broadcast);
+        } else {
+            channels[k] = channel_create(BENCH_CAPACITY);
+            args[k] = (bench_args) {channels[k], count};
+        }
+    }
+    uint64_t start = bench_time();
+    for (size_t k = 0; k < BENCH_FANOUT; k++) {
+        if (broadcast) {
+            pthread_create(&consumers[k], NULL, (void*)bench_cursor_consumer, cursors[k]);
+        } else {
+            pthread_create(&consumers[k], NULL, (void*)bench_consumer, &args[k]);
+        }
+    }
+    pthread_create(&producer, NULL, (void*)bench_fanout_producer, &fargs);
+    pthread_join(producer, NULL);
+    for (size_t k = 0; k < BENCH_FANOUT; k++) {
+        pthread_join(consumers[k], NULL);
+    }
+    uint64_t elapsed = bench_time() - start;
+    if (broadcast) {
+        broadcast_close(fargs.broadcast);
+        broadcast_destroy(fargs.broadcast);
+    } else {
+        for (size_t k = 0; k < BENCH_FANOUT; k++) {
+            channel_close(channels[k]);
+            channel_destroy(channels[k]);
+        }
+    }
+    return (double)count * 1000.0 / (double)elapsed;
+}
+
+void bench_broadcast(size_t max_threads)
+{
+    (void)max_threads;
+    printf("broadcast: one producer, every message to %d consumers, capacity %d (Mmsg/s sent)\n", BENCH_FANOUT, BENCH_CAPACITY);
+    printf("%10s %10s\n", "channels", "broadcast");
+    double channels = run_fanout(false);
+    double broadcast = run_fanout(true);
+    printf("%10.2f %10.2f\n", channels, broadcast);
+}
+
+typedef struct {
+    uint64_t words[BENCH_RECORD_WORDS];
+} bench_record;
+
+void* bench_record_producer(bench_args* myargs)
+{
+    bool typed = myargs->channel->kind == CHANNEL_TYPED;
+    for (size_t i = 1; i <= myargs->count; i++) {
+        bench_record record = {{i, i, i, i}};
+        enum channel_status status;
+        if (typed) {
+            status = channel_send_value(myargs->channel, &record);         // Copied into the ring
+        } else {
+            bench_record* copy = malloc(sizeof(bench_record));             // The consumer frees it
+            *copy = record;
+            status = channel_send(myargs->channel, copy);
+        }
+        assert(status == SUCCESS);
+        (void)status;
+    }
+    return NULL;
+}
+
+void* bench_record_consumer(bench_args* myargs)
+{
+    bool typed = myargs->channel->kind == CHANNEL_TYPED;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < myargs->count; i++) {
+        bench_record record;
+        enum channel_status status;
+        if (typed) {
+            status = channel_receive_value(myargs->channel, &record);
+        } else {
+            void* data;
+            status = channel_receive(myargs->channel, &data);
+            record = *(bench_record*)data;
+            free(data);
+        }
+        assert(status == SUCCESS);
+        (void)status;
+        sum += record.words[BENCH_RECORD_WORDS - 1];
+    }
+    return (void*)(uintptr_t)sum;
+}
+
+// Same as run_fan, but every message is a bench_record: malloc'd and freed around a pointer channel,
+// or copied through a typed channel
+double run_records(channel_t* channel, size_t pairs, size_t messages)
+{
+    pthread_t producers[pairs], consumers[pairs];
+    bench_args args = {channel, messages / pairs};
+    uint64_t start = bench_time();
+    for (size_t i = 0; i < pairs; i++) {
+        pthread_create(&consumers[i], NULL, (void*)bench_record_consumer, &args);
+        pthread_create(&producers[i], NULL, (void*)bench_record_producer, &args);
+    }
+    for (size_t i = 0; i < pairs; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+    uint64_t elapsed = bench_time() - start;
+    channel_close(channel);
+    channel_destroy(channel);
+    return (double)(args.count * pairs) * 1000.0 / (double)elapsed;
+}
+
+void bench_typed(size_t max_threads)
+{
+    printf("typed: N producers, N consumers, %zu-byte records, capacity %d (Mmsg/s)\n", sizeof(bench_record), BENCH_CAPACITY);
+    printf("%8s %10s %10s\n", "threads", "malloc", "typed");
+    for (size_t pairs = 1; 2 * pairs <= max_threads; pairs *= 2) {
+        double pointers = run_records(channel_create_mpmc(BENCH_CAPACITY), pairs, BENCH_MESSAGES);
+        double typed = run_records(channel_create_typed(sizeof(bench_record), BENCH_CAPACITY), pairs, BENCH_MESSAGES);
+        printf("%8zu %10.2f %10.2f\n", 2 * pairs, pointers, typed);
+    }
+}
+
+// Opens a counter of hardware cache misses for this thread and the threads it creates from then on
+// Returns -1 if there is none (no PMU, as in most VMs, or perf_event_paranoid forbids it)
+int perf_open_cache_misses()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.inherit = 1;                                       // Threads count into this counter when they exit
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Runs run_fan with one producer and one consumer, storing the cache misses per message in misses (-1 without a counter)
+double run_counted(channel_t* channel, double* misses)
+{
+    int fd = perf_open_cache_misses();
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    double rate = run_fan(channel, 1, BENCH_MESSAGES);
+    uint64_t count = 0;
+    *misses = -1;
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+            *misses = (double)count / BENCH_MESSAGES;
+        }
+        close(fd);
+    }
+    return rate;
+}
+
+// Prints one row per backend for the layout this binary was built with; make bench runs it in
+// channel_bench (padded) and channel_bench_packed (make PAD=0), so the two layouts can be compared
+void bench_cache(size_t max_threads)
+{
+    (void)max_threads;
+    const char* layout = CHANNEL_PAD ? "padded" : "packed";
+    printf("cache: one producer, one consumer, capacity %d, %s layout (Mmsg/s, hardware cache misses per message)\n", BENCH_CAPACITY, layout);
+    printf("%8s %8s %10s %10s\n", "backend", "layout", "Mmsg/s", "misses");
+    const char* names[] = {"mutex", "spsc", "mpmc"};
+    for (size_t i = 0; i < 3; i++) {
+        channel_t* channel = i == 0 ? channel_create(BENCH_CAPACITY) :
+                             i == 1 ? channel_create_spsc(BENCH_CAPACITY) : channel_create_mpmc(BENCH_CAPACITY);
+        double misses;
+        double rate = run_counted(channel, &misses);
+        if (misses < 0) {
+            printf("%8s %8s %10.2f %10s\n", names[i], layout, rate, "n/a");
+        } else {
+            printf("%8s %8s %10.2f %10.2f\n", names[i], layout, rate, misses);
+        }
+    }
+}
+
+// Creates BENCH_NODES channels of capacity 1 one by one or as one array, passes a message through each,
+// and destroys them, storing the time each phase took in ms
+void run_nodes(bool array, double ms[3])
+{
+    channel_t** channels = array ? NULL : malloc(BENCH_NODES * sizeof(channel_t*));
+    uint64_t start = bench_time();
+    if (array) {
+        channels = channel_create_array(BENCH_NODES, 1);
+    } else {
+        for (size_t i = 0; i < BENCH_NODES; i++) {
+            channels[i] = channel_create(1);
+        }
+    }
+    uint64_t created = bench_time();
+    for (size_t i = 0; i < BENCH_NODES; i++) {
+        void* data;
+        channel_send(channels[i], (void*)i);
+        channel_receive(channels[i], &data);
+    }
+    uint64_t used = bench_time();
+    for (size_t i = 0; i < BENCH_NODES; i++) {
+        channel_close(channels[i]);
+    }
+    if (array) {
+        channel_destroy_array(channels, BENCH_NODES);
+    } else {
+        for (size_t i = 0; i < BENCH_NODES; i++) {
+            channel_destroy(channels[i]);
+        }
+        free(channels);
+    }
+    uint64_t destroyed = bench_time();
+    ms[0] = (double)(created - start) / 1e6;
+    ms[1] = (double)(used - created) / 1e6;
+    ms[2] = (double)(destroyed - used) / 1e6;
+}
+
+void bench_arena(size_t max_threads)
+{
+    (void)max_threads;
+    printf("arena: %d channels of capacity 1, created one by one or by channel_create_array (ms)\n", BENCH_NODES);
+    printf("%8s %10s %10s %10s\n", "", "create", "use", "destroy");
+    double ms[3];
+    run_nodes(false, ms);
+    printf("%8s %10.2f %10.2f %10.2f\n", "single", ms[0], ms[1], ms[2]);
+    run_nodes(true, ms);
+    printf("%8s %10.2f %10.2f %10.2f\n", "array", ms[0], ms[1], ms[2]);
+}
+
+// Times trace_record while recording and while stopped, and a send/receive pair on a channel
+// (which records events only in a TRACE=1 build)
+void bench_trace(size_t max_threads)
+{
+    (void)max_threads;
+    printf("trace: cost of one event (ns)\n");
+    printf("%10s %10s %10s\n", "recording", "stopped", "send+recv");
+    trace_start();
+    uint64_t start = bench_time();
+    for (size_t i = 0; i < BENCH_EVENTS; i++) {
+        trace_record(TRACE_WAKE, &start, (int32_t)i);
+    }
+    uint64_t recording = bench_time() - start;
+    trace_stop();
+    start = bench_time();
+    for (size_t i = 0; i < BENCH_EVENTS; i++) {
+        trace_record(TRACE_WAKE, &start, (int32_t)i);
+    }
+    uint64_t stopped = bench_time() - start;
+
+    channel_t* channel = channel_create(1);
+    void* data;
+    trace_start();
+    start = bench_time();
+    for (size_t i = 0; i < BENCH_MESSAGES; i++) {
+        channel_send(channel, (void*)i);
+        channel_receive(channel, &data);
+    }
+    uint64_t pair = bench_time() - start;
+    trace_stop();
+    channel_close(channel);
+    channel_destroy(channel);
+    printf("%10.2f %10.2f %10.2f\n", (double)recording / BENCH_EVENTS, (double)stopped / BENCH_EVENTS, (double)pair / BENCH_MESSAGES);
+}
+
+// Streams messages through a mutex channel without and with latency histograms attached,
+// then prints the tail of what they recorded
+void bench_latency(size_t max_threads)
+{
+    (void)max_threads;
+    printf("latency: one producer, one consumer, capacity %d, histograms detached or attached (Mmsg/s)\n", BENCH_CAPACITY);
+    printf("%10s %10s\n", "detached", "attached");
+    double detached = run_fan(channel_create(BENCH_CAPACITY), 1, BENCH_MESSAGES);
+    channel_latency_t latency = {histogram_create(), histogram_create(), histogram_create(), NULL};
+    channel_t* channel = channel_create(BENCH_CAPACITY);
+    channel_attach_latency(channel, &latency);
+    double attached = run_fan(channel, 1, BENCH_MESSAGES);
+    printf("%10.2f %10.2f\n", detached, attached);
+    histogram_print(latency.sojourn, "sojourn (ns)", stdout);
+    histogram_print(latency.send, "send wait (ns)", stdout);
+    histogram_print(latency.receive, "receive wait (ns)", stdout);
+    histogram_free(latency.sojourn);
+    histogram_free(latency.send);
+    histogram_free(latency.receive);
+}
+
+typedef void (*bench_fn_t)(size_t max_threads);
+typedef struct {
+    char* name;
+    bench_fn_t bench;
+} bench_t;
+
+bench_t benches[] = {{"spsc", bench_spsc},
+                     {"mpmc", bench_mpmc},
+                     {"batch", bench_batch},
+                     {"pingpong", bench_pingpong},
+                     {"wait", bench_wait},
+                     {"router", bench_router},
+                     {"fair", bench_fair},
+                     {"broadcast", bench_broadcast},
+                     {"typed", bench_typed},
+                     {"cache", bench_cache},
+                     {"arena", bench_arena},
+                     {"trace", bench_trace},
+                     {"latency", bench_latency},
+};
+
+size_t num_benches = sizeof(benches)/sizeof(benches[0]);
+
+int main(int argc, char** argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = cpus > 1 ? (size_t)cpus * 2 : 2;
+    if (argc >= 3) {
+        max_threads = (size_t)atoi(argv[2]);
+    }
+    if (argc == 1 || strcmp(argv[1], "all") == 0) {
+        for (size_t i = 0; i < num_benches; i++) {
+            benches[i].bench(max_threads);
+        }
+        return 0;
+    }
+    for (size_t i = 0; i < num_benches; i++) {
+        if (strcmp(argv[1], benches[i].name) == 0) {
+            benches[i].bench(max_threads);
+            return 0;
+        }
+    }
+    printf("Did not find benchmark\n");
+    return 1;
+}
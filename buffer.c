@@ -1,22 +1,289 @@
+#include <string.h>
+#include <stdint.h>
 #include "buffer.h"
 
+// Returns the smallest power of two that is >= n (n must be > 0)
+static size_t round_up_pow2(size_t n)
+{
+    size_t pow2 = 1;
+    while (pow2 < n) {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity)
 {
-    buffer_t* buffer = (buffer_t*) malloc(sizeof(buffer_t));
+    buffer_t* buffer = (buffer_t*) aligned_alloc(CACHE_ALIGNMENT, sizeof(buffer_t));
     void** data  = (void**) malloc(capacity * sizeof(void*));
     buffer->size = 0;
     buffer->next = 0;
     buffer->capacity = capacity;
     buffer->data = data;
+    buffer->mask = 0;
+    buffer->segment_size = 0;
+    buffer->head = NULL;
+    buffer->tail = NULL;
+    buffer->end = 0;
+    buffer->spare = NULL;
+    buffer->spare_count = 0;
+    buffer->heap = NULL;
+    buffer->seq = 0;
+    return buffer;
+}
+
+// Creates a ring buffer with the given capacity, indexed by running counters over a power-of-two number of slots
+// Returns NULL if capacity is 0 or memory ran out
+buffer_t* buffer_create_pow2(size_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    buffer_t* buffer = (buffer_t*) aligned_alloc(CACHE_ALIGNMENT, sizeof(buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    void** data = (void**) malloc(buffer_pow2_slots(capacity) * sizeof(void*));
+    if (data == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    buffer_init_pow2(buffer, data, capacity);
     return buffer;
 }
 
+// Returns the number of slots a power-of-two ring of the given capacity uses
+size_t buffer_pow2_slots(size_t capacity)
+{
+    return round_up_pow2(capacity < 2 ? 2 : capacity);     // 2 slots at least, so mask is never 0
+}
+
+// Sets up a power-of-two ring of the given capacity in memory the caller owns
+void buffer_init_pow2(buffer_t* buffer, void** data, size_t capacity)
+{
+    buffer->size = 0;
+    buffer->next = 0;
+    buffer->end = 0;
+    buffer->capacity = capacity;
+    buffer->data = data;
+    buffer->mask = buffer_pow2_slots(capacity) - 1;
+    buffer->segment_size = 0;
+    buffer->heap = NULL;
+    buffer->head = NULL;
+    buffer->tail = NULL;
+    buffer->spare = NULL;
+    buffer->spare_count = 0;
+    buffer->seq = 0;
+}
+
+// Takes a segment from the spare list, or allocates one if it is empty
+static buffer_segment_t* segment_take(buffer_t* buffer)
+{
+    buffer_segment_t* segment = buffer->spare;
+    if (segment) {
+        buffer->spare = segment->next;
+        buffer->spare_count--;
+    } else {
+        segment = (buffer_segment_t*) malloc(sizeof(buffer_segment_t) + buffer->segment_size * sizeof(void*));
+        if (segment == NULL) {
+            return NULL;
+        }
+    }
+    segment->next = NULL;
+    return segment;
+}
+
+// Puts a drained segment on the spare list, or frees it if the list is full
+static void segment_release(buffer_t* buffer, buffer_segment_t* segment)
+{
+    if (buffer->spare_count >= BUFFER_SPARE_SEGMENTS) {
+        free(segment);
+        return;
+    }
+    segment->next = buffer->spare;
+    buffer->spare = segment;
+    buffer->spare_count++;
+}
+
+// Creates an unbounded buffer that allocates segment_size slots at a time
+// Returns NULL if segment_size is 0 or memory ran out
+buffer_t* buffer_create_unbounded(size_t segment_size)
+{
+    if (segment_size == 0) {
+        return NULL;
+    }
+    buffer_t* buffer = (buffer_t*) aligned_alloc(CACHE_ALIGNMENT, sizeof(buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->size = 0;
+    buffer->next = 0;
+    buffer->capacity = SIZE_MAX;
+    buffer->data = NULL;
+    buffer->mask = 0;
+    buffer->segment_size = segment_size;
+    buffer->spare = NULL;
+    buffer->spare_count = 0;
+    buffer->heap = NULL;
+    buffer->seq = 0;
+    buffer->head = segment_take(buffer);
+    if (buffer->head == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    buffer->tail = buffer->head;
+    buffer->end = 0;
+    return buffer;
+}
+
+// Creates a priority buffer with the given capacity
+// Returns NULL if capacity is 0 or memory ran out
+buffer_t* buffer_create_priority(size_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    buffer_t* buffer = (buffer_t*) aligned_alloc(CACHE_ALIGNMENT, sizeof(buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->heap = (buffer_heap_entry_t*) malloc(capacity * sizeof(buffer_heap_entry_t));
+    if (buffer->heap == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    buffer->size = 0;
+    buffer->next = 0;
+    buffer->capacity = capacity;
+    buffer->data = NULL;
+    buffer->mask = 0;
+    buffer->segment_size = 0;
+    buffer->head = NULL;
+    buffer->tail = NULL;
+    buffer->end = 0;
+    buffer->spare = NULL;
+    buffer->spare_count = 0;
+    buffer->seq = 0;
+    return buffer;
+}
+
+// Returns true if a has to leave a priority buffer before b
+static bool heap_before(const buffer_heap_entry_t* a, const buffer_heap_entry_t* b)
+{
+    return a->priority > b->priority || (a->priority == b->priority && a->seq < b->seq);
+}
+
+static enum buffer_status heap_add(buffer_t* buffer, void* data, int priority)
+{
+    if (buffer->size >= buffer->capacity) {
+        return BUFFER_ERROR;
+    }
+    buffer_heap_entry_t entry = {data, priority, buffer->seq++};
+    size_t i = buffer->size++;
+    while (i > 0) {                                         // Sift up: move parents that leave later down a level
+        size_t parent = (i - 1) / BUFFER_HEAP_ARITY;
+        if (!heap_before(&entry, &buffer->heap[parent])) {
+            break;
+        }
+        buffer->heap[i] = buffer->heap[parent];
+        i = parent;
+    }
+    buffer->heap[i] = entry;
+    return BUFFER_SUCCESS;
+}
+
+static enum buffer_status heap_remove(buffer_t* buffer, void** data)
+{
+    if (buffer->size == 0) {
+        return BUFFER_ERROR;
+    }
+    *data = buffer->heap[0].data;
+    buffer_heap_entry_t last = buffer->heap[--buffer->size];
+    size_t size = buffer->size;
+    size_t i = 0;
+    while (true) {                                          // Sift down: move the first child to leave up a level
+        size_t first = i * BUFFER_HEAP_ARITY + 1;
+        if (first >= size) {
+            break;
+        }
+        size_t stop = first + BUFFER_HEAP_ARITY < size ? first + BUFFER_HEAP_ARITY : size;
+        size_t best = first;
+        for (size_t child = first + 1; child < stop; child++) {
+            if (heap_before(&buffer->heap[child], &buffer->heap[best])) {
+                best = child;
+            }
+        }
+        if (!heap_before(&buffer->heap[best], &last)) {
+            break;
+        }
+        buffer->heap[i] = buffer->heap[best];
+        i = best;
+    }
+    buffer->heap[i] = last;
+    return BUFFER_SUCCESS;
+}
+
+// Makes room for at least one more value at the end of an unbounded buffer
+// Returns false if the tail segment is full and no segment could be allocated
+static bool segmented_reserve(buffer_t* buffer)
+{
+    if (buffer->end < buffer->segment_size) {
+        return true;
+    }
+    buffer_segment_t* segment = segment_take(buffer);
+    if (segment == NULL) {
+        return false;
+    }
+    buffer->tail->next = segment;
+    buffer->tail = segment;
+    buffer->end = 0;
+    return true;
+}
+
+// Retires the head segment of an unbounded buffer once it is drained, after a remove
+static void segmented_advance(buffer_t* buffer)
+{
+    if (buffer->size == 0) {
+        buffer->next = 0;                               // head == tail: start over at its front
+        buffer->end = 0;
+    } else if (buffer->next == buffer->segment_size) {
+        buffer_segment_t* drained = buffer->head;
+        buffer->head = drained->next;
+        buffer->next = 0;
+        segment_release(buffer, drained);
+    }
+}
+
+// Number of values that can be read from the head segment of an unbounded buffer without advancing
+static size_t segmented_readable(buffer_t* buffer)
+{
+    return (buffer->head == buffer->tail ? buffer->end : buffer->segment_size) - buffer->next;
+}
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_add(buffer_t* buffer, void* data)
 {
+    if (buffer->mask) {                                     // Power-of-two ring: one counter, no wrap-around
+        if (buffer->end - buffer->next >= buffer->capacity) {
+            return BUFFER_ERROR;
+        }
+        buffer->data[buffer->end++ & buffer->mask] = data;
+        return BUFFER_SUCCESS;
+    }
+    if (buffer->heap) {
+        return heap_add(buffer, data, 0);
+    }
+    if (buffer->segment_size) {
+        if (!segmented_reserve(buffer)) {
+            return BUFFER_ERROR;
+        }
+        buffer->tail->data[buffer->end++] = data;
+        buffer->size++;
+        return BUFFER_SUCCESS;
+    }
     if (buffer->size >= buffer->capacity) {
         return BUFFER_ERROR;
     }
@@ -34,6 +301,22 @@ enum buffer_status buffer_add(buffer_t* buffer, void* data)
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_remove(buffer_t* buffer, void **data)
 {
+    if (buffer->mask) {
+        if (buffer->end == buffer->next) {
+            return BUFFER_ERROR;
+        }
+        *data = buffer->data[buffer->next++ & buffer->mask];
+        return BUFFER_SUCCESS;
+    }
+    if (buffer->heap) {
+        return heap_remove(buffer, data);
+    }
+    if (buffer->segment_size && buffer->size > 0) {
+        *data = buffer->head->data[buffer->next++];
+        buffer->size--;
+        segmented_advance(buffer);
+        return BUFFER_SUCCESS;
+    }
     if (buffer->size > 0) {
         *data = buffer->data[buffer->next];
         buffer->size--;
@@ -46,9 +329,143 @@ enum buffer_status buffer_remove(buffer_t* buffer, void **data)
     return BUFFER_ERROR;
 }
 
+// Same as buffer_add, but a priority buffer orders the value by priority
+enum buffer_status buffer_add_priority(buffer_t* buffer, void* data, int priority)
+{
+    if (buffer->heap) {
+        return heap_add(buffer, data, priority);
+    }
+    return buffer_add(buffer, data);
+}
+
+// Copies count values from data into the ring of the given size starting at slot pos,
+// wrapping around at most once (so at most two memcpy calls)
+static void ring_copy_in(void** ring, size_t ring_size, size_t pos, void** data, size_t count)
+{
+    size_t first = ring_size - pos;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(&ring[pos], data, first * sizeof(void*));
+    memcpy(ring, &data[first], (count - first) * sizeof(void*));
+}
+
+// Copies count values out of the ring of the given size starting at slot pos into data
+static void ring_copy_out(void** ring, size_t ring_size, size_t pos, void** data, size_t count)
+{
+    size_t first = ring_size - pos;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(data, &ring[pos], first * sizeof(void*));
+    memcpy(&data[first], ring, (count - first) * sizeof(void*));
+}
+
+// Adds up to count values from data into the buffer in order
+// Returns the number of values added (0 if the buffer is full)
+size_t buffer_add_batch(buffer_t* buffer, void** data, size_t count)
+{
+    if (buffer->mask) {
+        size_t space = buffer->capacity - (buffer->end - buffer->next);
+        if (count > space) {
+            count = space;
+        }
+        ring_copy_in(buffer->data, buffer->mask + 1, buffer->end & buffer->mask, data, count);
+        buffer->end += count;
+        return count;
+    }
+    if (buffer->heap) {
+        size_t added = 0;
+        while (added < count && heap_add(buffer, data[added], 0) == BUFFER_SUCCESS) {
+            added++;
+        }
+        return added;
+    }
+    if (buffer->segment_size) {
+        size_t added = 0;
+        while (added < count && segmented_reserve(buffer)) {   // One memcpy per segment
+            size_t n = buffer->segment_size - buffer->end;
+            if (n > count - added) {
+                n = count - added;
+            }
+            memcpy(&buffer->tail->data[buffer->end], &data[added], n * sizeof(void*));
+            buffer->end += n;
+            buffer->size += n;
+            added += n;
+        }
+        return added;
+    }
+    size_t space = buffer->capacity - buffer->size;
+    if (count > space) {
+        count = space;
+    }
+    size_t pos = buffer->next + buffer->size;
+    if (pos >= buffer->capacity) {
+        pos -= buffer->capacity;
+    }
+    ring_copy_in(buffer->data, buffer->capacity, pos, data, count);
+    buffer->size += count;
+    return count;
+}
+
+// Removes up to count values from the buffer in FIFO order and stores them in data
+// Returns the number of values removed (0 if the buffer is empty)
+size_t buffer_remove_batch(buffer_t* buffer, void** data, size_t count)
+{
+    if (buffer->mask) {
+        if (count > buffer->end - buffer->next) {
+            count = buffer->end - buffer->next;
+        }
+        ring_copy_out(buffer->data, buffer->mask + 1, buffer->next & buffer->mask, data, count);
+        buffer->next += count;
+        return count;
+    }
+    if (buffer->heap) {
+        size_t removed = 0;
+        while (removed < count && heap_remove(buffer, &data[removed]) == BUFFER_SUCCESS) {
+            removed++;
+        }
+        return removed;
+    }
+    if (buffer->segment_size) {
+        size_t removed = 0;
+        while (removed < count && buffer->size > 0) {
+            size_t n = segmented_readable(buffer);
+            if (n > count - removed) {
+                n = count - removed;
+            }
+            memcpy(&data[removed], &buffer->head->data[buffer->next], n * sizeof(void*));
+            buffer->next += n;
+            buffer->size -= n;
+            removed += n;
+            segmented_advance(buffer);
+        }
+        return removed;
+    }
+    if (count > buffer->size) {
+        count = buffer->size;
+    }
+    ring_copy_out(buffer->data, buffer->capacity, buffer->next, data, count);
+    buffer->size -= count;
+    buffer->next += count;
+    if (buffer->next >= buffer->capacity) {
+        buffer->next -= buffer->capacity;
+    }
+    return count;
+}
+
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t *buffer)
 {
+    buffer_segment_t* lists[] = {buffer->head, buffer->spare};
+    for (size_t i = 0; i < 2; i++) {
+        while (lists[i]) {
+            buffer_segment_t* next = lists[i]->next;
+            free(lists[i]);
+            lists[i] = next;
+        }
+    }
+    free(buffer->heap);
     free(buffer->data);
     free(buffer);
 }
@@ -62,6 +479,9 @@ size_t buffer_capacity(buffer_t* buffer)
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer)
 {
+    if (buffer->mask) {
+        return buffer->end - buffer->next;
+    }
     return buffer->size;
 }
 
@@ -69,5 +489,386 @@ size_t buffer_current_size(buffer_t* buffer)
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index)
 {
+    if (buffer->heap) {
+        return buffer->heap[index].data;
+    }
+    if (buffer->segment_size) {
+        buffer_segment_t* segment = buffer->head;
+        index += buffer->next;
+        while (index >= buffer->segment_size) {
+            segment = segment->next;
+            index -= buffer->segment_size;
+        }
+        return segment->data[index];
+    }
     return buffer->data[index];
 }
+
+// Creates a single-producer/single-consumer buffer with the given capacity
+spsc_buffer_t* spsc_buffer_create(size_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    spsc_buffer_t* buffer = (spsc_buffer_t*) aligned_alloc(CACHE_LINE_SIZE, sizeof(spsc_buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    size_t slots = round_up_pow2(capacity);
+    buffer->data = (void**) malloc(slots * sizeof(void*));
+    if (buffer->data == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    atomic_init(&buffer->head, 0);
+    atomic_init(&buffer->tail, 0);
+    buffer->cached_head = 0;
+    buffer->cached_tail = 0;
+    buffer->capacity = capacity;
+    buffer->mask = slots - 1;
+    return buffer;
+}
+
+// Adds the value into the buffer; must only be called by the producer thread
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status spsc_buffer_add(spsc_buffer_t* buffer, void* data)
+{
+    size_t tail = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+    if (tail - buffer->cached_head >= buffer->capacity) {
+        // looks full; refresh our view of the consumer
+        buffer->cached_head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        if (tail - buffer->cached_head >= buffer->capacity) {
+            return BUFFER_ERROR;
+        }
+    }
+    buffer->data[tail & buffer->mask] = data;
+    atomic_store_explicit(&buffer->tail, tail + 1, memory_order_release);
+    return BUFFER_SUCCESS;
+}
+
+// Removes the value from the buffer in FIFO order; must only be called by the consumer thread
+// Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
+// Returns BUFFER_ERROR otherwise
+enum buffer_status spsc_buffer_remove(spsc_buffer_t* buffer, void** data)
+{
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    if (head == buffer->cached_tail) {
+        // looks empty; refresh our view of the producer
+        buffer->cached_tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+        if (head == buffer->cached_tail) {
+            return BUFFER_ERROR;
+        }
+    }
+    *data = buffer->data[head & buffer->mask];
+    atomic_store_explicit(&buffer->head, head + 1, memory_order_release);
+    return BUFFER_SUCCESS;
+}
+
+// Adds up to count values from data into the buffer; must only be called by the producer thread
+// Returns the number of values added (0 if the buffer is full)
+size_t spsc_buffer_add_batch(spsc_buffer_t* buffer, void** data, size_t count)
+{
+    size_t tail = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+    if (tail - buffer->cached_head + count > buffer->capacity) {
+        buffer->cached_head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    }
+    size_t space = buffer->capacity - (tail - buffer->cached_head);
+    if (count > space) {
+        count = space;
+    }
+    ring_copy_in(buffer->data, buffer->mask + 1, tail & buffer->mask, data, count);
+    atomic_store_explicit(&buffer->tail, tail + count, memory_order_release);
+    return count;
+}
+
+// Removes up to count values in FIFO order into data; must only be called by the consumer thread
+// Returns the number of values removed (0 if the buffer is empty)
+size_t spsc_buffer_remove_batch(spsc_buffer_t* buffer, void** data, size_t count)
+{
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    if (buffer->cached_tail - head < count) {
+        buffer->cached_tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    }
+    size_t available = buffer->cached_tail - head;
+    if (count > available) {
+        count = available;
+    }
+    ring_copy_out(buffer->data, buffer->mask + 1, head & buffer->mask, data, count);
+    atomic_store_explicit(&buffer->head, head + count, memory_order_release);
+    return count;
+}
+
+// Frees the memory allocated to the buffer
+void spsc_buffer_free(spsc_buffer_t* buffer)
+{
+    free(buffer->data);
+    free(buffer);
+}
+
+// Returns the total capacity of the buffer
+size_t spsc_buffer_capacity(spsc_buffer_t* buffer)
+{
+    return buffer->capacity;
+}
+
+// Returns the current number of elements in the buffer (a snapshot when used concurrently)
+size_t spsc_buffer_current_size(spsc_buffer_t* buffer)
+{
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    return tail - head;
+}
+
+// Maps a free-running position onto a slot of an mpmc buffer
+static size_t mpmc_index(mpmc_buffer_t* buffer, size_t pos)
+{
+    return buffer->mask ? (pos & buffer->mask) : (pos % buffer->capacity);
+}
+
+// Creates a multi-producer/multi-consumer buffer with the given capacity
+mpmc_buffer_t* mpmc_buffer_create(size_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    mpmc_buffer_t* buffer = (mpmc_buffer_t*) aligned_alloc(CACHE_LINE_SIZE, sizeof(mpmc_buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    buffer->slots = (mpmc_slot_t*) malloc(capacity * sizeof(mpmc_slot_t));
+    if (buffer->slots == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&buffer->slots[i].seq, 2 * i);
+        buffer->slots[i].data = NULL;
+    }
+    atomic_init(&buffer->head, 0);
+    atomic_init(&buffer->tail, 0);
+    buffer->capacity = capacity;
+    buffer->mask = (round_up_pow2(capacity) == capacity) ? capacity - 1 : 0;
+    return buffer;
+}
+
+// Adds the value into the buffer; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status mpmc_buffer_add(mpmc_buffer_t* buffer, void* data)
+{
+    size_t pos = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+    mpmc_slot_t* slot;
+    while (true) {
+        slot = &buffer->slots[mpmc_index(buffer, pos)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - 2 * pos);
+        if (diff == 0) {
+            // slot is free for this position; try to claim it
+            if (atomic_compare_exchange_weak_explicit(&buffer->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the consumer one lap behind has not emptied the slot yet
+            return BUFFER_ERROR;
+        } else {
+            // another producer claimed this position first
+            pos = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+        }
+    }
+    slot->data = data;
+    atomic_store_explicit(&slot->seq, 2 * pos + 1, memory_order_release);
+    return BUFFER_SUCCESS;
+}
+
+// Removes the value from the buffer in FIFO order; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
+// Returns BUFFER_ERROR otherwise
+enum buffer_status mpmc_buffer_remove(mpmc_buffer_t* buffer, void** data)
+{
+    size_t pos = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    mpmc_slot_t* slot;
+    while (true) {
+        slot = &buffer->slots[mpmc_index(buffer, pos)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - (2 * pos + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&buffer->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the producer for this position has not published yet
+            return BUFFER_ERROR;
+        } else {
+            pos = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+        }
+    }
+    *data = slot->data;
+    atomic_store_explicit(&slot->seq, 2 * (pos + buffer->capacity), memory_order_release);
+    return BUFFER_SUCCESS;
+}
+
+// Returns true if the next add would fail because the slot is still occupied
+bool mpmc_buffer_full(mpmc_buffer_t* buffer)
+{
+    size_t pos = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    size_t seq = atomic_load_explicit(&buffer->slots[mpmc_index(buffer, pos)].seq, memory_order_acquire);
+    return (ptrdiff_t)(seq - 2 * pos) < 0;
+}
+
+// Returns true if the next remove would fail because the slot has not been filled yet
+bool mpmc_buffer_empty(mpmc_buffer_t* buffer)
+{
+    size_t pos = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    size_t seq = atomic_load_explicit(&buffer->slots[mpmc_index(buffer, pos)].seq, memory_order_acquire);
+    return (ptrdiff_t)(seq - (2 * pos + 1)) < 0;
+}
+
+// Frees the memory allocated to the buffer
+void mpmc_buffer_free(mpmc_buffer_t* buffer)
+{
+    free(buffer->slots);
+    free(buffer);
+}
+
+// Returns the total capacity of the buffer
+size_t mpmc_buffer_capacity(mpmc_buffer_t* buffer)
+{
+    return buffer->capacity;
+}
+
+// Returns the current number of elements in the buffer (a snapshot when used concurrently)
+size_t mpmc_buffer_current_size(mpmc_buffer_t* buffer)
+{
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
+
+// Sequence number at the start of the cell for position pos
+static atomic_size_t* value_cell(value_buffer_t* buffer, size_t pos)
+{
+    size_t index = buffer->mask ? (pos & buffer->mask) : (pos % buffer->capacity);
+    return (atomic_size_t*) (buffer->cells + index * buffer->stride);
+}
+
+// Creates a buffer of capacity values of elem_size bytes each
+value_buffer_t* value_buffer_create(size_t elem_size, size_t capacity)
+{
+    if (elem_size == 0 || capacity == 0) {
+        return NULL;
+    }
+    value_buffer_t* buffer = (value_buffer_t*) aligned_alloc(CACHE_LINE_SIZE, sizeof(value_buffer_t));
+    if (buffer == NULL) {
+        return NULL;
+    }
+    size_t align = _Alignof(max_align_t);
+    buffer->stride = (sizeof(atomic_size_t) + elem_size + align - 1) / align * align;
+    buffer->cells = (unsigned char*) malloc(capacity * buffer->stride);
+    if (buffer->cells == NULL) {
+        free(buffer);
+        return NULL;
+    }
+    buffer->capacity = capacity;
+    buffer->mask = (round_up_pow2(capacity) == capacity) ? capacity - 1 : 0;
+    buffer->elem_size = elem_size;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(value_cell(buffer, i), 2 * i);
+    }
+    atomic_init(&buffer->head, 0);
+    atomic_init(&buffer->tail, 0);
+    return buffer;
+}
+
+// Copies elem_size bytes from value into the buffer; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status value_buffer_add(value_buffer_t* buffer, const void* value)
+{
+    size_t pos = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+    atomic_size_t* cell;
+    while (true) {
+        cell = value_cell(buffer, pos);
+        size_t seq = atomic_load_explicit(cell, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - 2 * pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&buffer->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return BUFFER_ERROR;
+        } else {
+            pos = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+        }
+    }
+    memcpy(cell + 1, value, buffer->elem_size);
+    atomic_store_explicit(cell, 2 * pos + 1, memory_order_release);
+    return BUFFER_SUCCESS;
+}
+
+// Copies the oldest value into value (elem_size bytes) and removes it; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
+// Returns BUFFER_ERROR otherwise
+enum buffer_status value_buffer_remove(value_buffer_t* buffer, void* value)
+{
+    size_t pos = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    atomic_size_t* cell;
+    while (true) {
+        cell = value_cell(buffer, pos);
+        size_t seq = atomic_load_explicit(cell, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - (2 * pos + 1));
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&buffer->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return BUFFER_ERROR;
+        } else {
+            pos = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+        }
+    }
+    memcpy(value, cell + 1, buffer->elem_size);
+    atomic_store_explicit(cell, 2 * (pos + buffer->capacity), memory_order_release);
+    return BUFFER_SUCCESS;
+}
+
+// Returns true if the next add would fail because the cell is still occupied
+bool value_buffer_full(value_buffer_t* buffer)
+{
+    size_t pos = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    size_t seq = atomic_load_explicit(value_cell(buffer, pos), memory_order_acquire);
+    return (ptrdiff_t)(seq - 2 * pos) < 0;
+}
+
+// Returns true if the next remove would fail because the cell has not been filled yet
+bool value_buffer_empty(value_buffer_t* buffer)
+{
+    size_t pos = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    size_t seq = atomic_load_explicit(value_cell(buffer, pos), memory_order_acquire);
+    return (ptrdiff_t)(seq - (2 * pos + 1)) < 0;
+}
+
+// Frees the memory allocated to the buffer
+void value_buffer_free(value_buffer_t* buffer)
+{
+    free(buffer->cells);
+    free(buffer);
+}
+
+// Returns the total capacity of the buffer
+size_t value_buffer_capacity(value_buffer_t* buffer)
+{
+    return buffer->capacity;
+}
+
+// Returns the current number of values in the buffer (a snapshot when used concurrently)
+size_t value_buffer_current_size(value_buffer_t* buffer)
+{
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&buffer->tail, memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
@@ -2,12 +2,72 @@
 #define BUFFER_H
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
+// Size of a cache line; used to keep producer and consumer state apart
+#define CACHE_LINE_SIZE 64
+
+// Channels and their buffers are laid out in cache lines (CACHE_ALIGNED fields, CACHE_ALIGNMENT allocations)
+// make PAD=0 builds them packed instead, as they were before, for the cache benchmark to compare against
+#ifndef CHANNEL_PAD
+#define CHANNEL_PAD 1
+#endif
+#if CHANNEL_PAD
+#define CACHE_ALIGNED _Alignas(CACHE_LINE_SIZE)
+#define CACHE_ALIGNMENT CACHE_LINE_SIZE
+#else
+#define CACHE_ALIGNED
+#define CACHE_ALIGNMENT _Alignof(max_align_t)
+#endif
+
+// Drained segments an unbounded buffer keeps for reuse; any more are freed, so an idle buffer
+// holds at most this many segments besides the one it writes to
+#define BUFFER_SPARE_SEGMENTS 4
+
+// Block of slots in an unbounded buffer; segments are linked oldest first
+typedef struct buffer_segment {
+    struct buffer_segment* next;
+    void* data[];
+} buffer_segment_t;
+
+// Children per node of a priority buffer's heap; four entries of a level sit next to each other,
+// so sifting down touches fewer, fuller cache lines than a binary heap and the tree is half as deep
+#define BUFFER_HEAP_ARITY 4
+
+// Value in a priority buffer, ordered by priority and then by arrival
 typedef struct {
-    size_t size;
-    size_t next;
-    size_t capacity;
-    void** data;
+    void* data;
+    int priority;
+    size_t seq;                 // arrival order, so equal priorities come out FIFO
+} buffer_heap_entry_t;
+
+// Ring buffer of a fixed capacity, a power-of-two ring of a fixed capacity (buffer_create_pow2),
+// a queue of fixed-size segments (buffer_create_unbounded) that grows one segment at a time as the
+// backlog does, so nothing is ever copied, or a d-ary heap of a fixed capacity that hands out the
+// highest priority first (buffer_create_priority)
+// Only ever used with the channel mutex held, so producers and consumers take turns writing it rather than
+// sharing it; buffers are allocated aligned to CACHE_ALIGNMENT, so what a ring touches per operation
+// (up to heap) is one line that moves along with the lock
+typedef struct {
+    CACHE_ALIGNED size_t size;  // not kept up to date by a power-of-two ring; see buffer_current_size
+    size_t next;                // slot of the oldest value (in head, for an unbounded buffer),
+                                // or the number of values ever removed, for a power-of-two ring
+    size_t end;                 // slot in tail the next value goes into, for an unbounded buffer,
+                                // or the number of values ever added, for a power-of-two ring
+    size_t capacity;            // SIZE_MAX for an unbounded buffer
+    void** data;                // NULL for an unbounded buffer
+    size_t mask;                // slots - 1 for a power-of-two ring; 0 for any other buffer
+    size_t segment_size;        // slots per segment for an unbounded buffer; 0 for any other buffer
+    buffer_heap_entry_t* heap;  // heap entries for a priority buffer; NULL for any other buffer
+    // unbounded buffers only
+    buffer_segment_t* head;     // segment holding the oldest value
+    buffer_segment_t* tail;     // segment the next value goes into, at slot end
+    buffer_segment_t* spare;    // drained segments kept for reuse, at most BUFFER_SPARE_SEGMENTS
+    size_t spare_count;
+    // priority buffers only
+    size_t seq;                 // arrival number of the next value
 } buffer_t;
 
 enum buffer_status {
@@ -18,16 +78,50 @@ enum buffer_status {
 // Creates a buffer with the given capacity
 buffer_t* buffer_create(size_t capacity);
 
+// Creates a ring buffer with the given (positive) capacity whose slots are indexed by running counters:
+// a value goes to slot end & mask and comes from slot next & mask, so add and remove each write one
+// counter and neither has to wrap, and the size is simply end - next
+// Storage is rounded up to a power of two (at least 2) slots, but the buffer still holds at most capacity values
+// Returns NULL if capacity is 0 or memory ran out
+buffer_t* buffer_create_pow2(size_t capacity);
+
+// Returns the number of slots a power-of-two ring of the given (positive) capacity uses
+size_t buffer_pow2_slots(size_t capacity);
+
+// Sets up a power-of-two ring of the given (positive) capacity in memory the caller owns, with data
+// pointing to buffer_pow2_slots(capacity) slots; such a buffer must not be passed to buffer_free
+void buffer_init_pow2(buffer_t* buffer, void** data, size_t capacity);
+
+// Creates an unbounded buffer that allocates segment_size slots at a time
+// Returns NULL if segment_size is 0 or memory ran out
+buffer_t* buffer_create_unbounded(size_t segment_size);
+
+// Creates a priority buffer with the given capacity
+// Returns NULL if capacity is 0 or memory ran out
+buffer_t* buffer_create_priority(size_t capacity);
+
 // Adds the value into the buffer
 // Returns BUFFER_SUCCESS if the buffer is not full and value was added
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_add(buffer_t* buffer, void* data);
 
-// Removes the value from the buffer in FIFO order and stores it in data
+// Same as buffer_add, but a priority buffer hands the value out before every value of a lower priority
+// (and after those of the same priority added earlier); other buffers ignore priority
+enum buffer_status buffer_add_priority(buffer_t* buffer, void* data, int priority);
+
+// Removes the value from the buffer in FIFO order (highest priority first for a priority buffer) and stores it in data
 // Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
 // Returns BUFFER_ERROR otherwise
 enum buffer_status buffer_remove(buffer_t* buffer, void** data);
 
+// Adds up to count values from data into the buffer in order
+// Returns the number of values added (0 if the buffer is full)
+size_t buffer_add_batch(buffer_t* buffer, void** data, size_t count);
+
+// Removes up to count values from the buffer in FIFO order and stores them in data
+// Returns the number of values removed (0 if the buffer is empty)
+size_t buffer_remove_batch(buffer_t* buffer, void** data, size_t count);
+
 // Frees the memory allocated to the buffer
 void buffer_free(buffer_t* buffer);
 
@@ -37,8 +131,151 @@ size_t buffer_capacity(buffer_t* buffer);
 // Returns the current number of elements in the buffer
 size_t buffer_current_size(buffer_t* buffer);
 
-// Peeks at a value in the buffer
+// Peeks at a value in the buffer (for an unbounded buffer, index counts from the oldest value,
+// and for a priority buffer it is a position in the heap)
 // Only used for testing code; you should NOT use this
 void* peek_buffer(buffer_t* buffer, size_t index);
 
+// Lock-free single-producer/single-consumer ring buffer
+// head and tail are free-running counters; the slot index is counter & mask,
+// where mask + 1 is the capacity rounded up to a power of two
+// Each side keeps a private copy of the other side's counter so that the
+// shared cache line is only touched when the ring looks full (or empty)
+typedef struct {
+    // consumer-owned line
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    size_t cached_tail;
+    // producer-owned line
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    size_t cached_head;
+    // read-only after creation
+    _Alignas(CACHE_LINE_SIZE) size_t capacity;
+    size_t mask;
+    void** data;
+} spsc_buffer_t;
+
+// Creates a single-producer/single-consumer buffer with the given capacity
+spsc_buffer_t* spsc_buffer_create(size_t capacity);
+
+// Adds the value into the buffer; must only be called by the producer thread
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status spsc_buffer_add(spsc_buffer_t* buffer, void* data);
+
+// Removes the value from the buffer in FIFO order; must only be called by the consumer thread
+// Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
+// Returns BUFFER_ERROR otherwise
+enum buffer_status spsc_buffer_remove(spsc_buffer_t* buffer, void** data);
+
+// Adds up to count values from data into the buffer; must only be called by the producer thread
+// Returns the number of values added (0 if the buffer is full)
+size_t spsc_buffer_add_batch(spsc_buffer_t* buffer, void** data, size_t count);
+
+// Removes up to count values in FIFO order into data; must only be called by the consumer thread
+// Returns the number of values removed (0 if the buffer is empty)
+size_t spsc_buffer_remove_batch(spsc_buffer_t* buffer, void** data, size_t count);
+
+// Frees the memory allocated to the buffer
+void spsc_buffer_free(spsc_buffer_t* buffer);
+
+// Returns the total capacity of the buffer
+size_t spsc_buffer_capacity(spsc_buffer_t* buffer);
+
+// Returns the current number of elements in the buffer (a snapshot when used concurrently)
+size_t spsc_buffer_current_size(spsc_buffer_t* buffer);
+
+// Lock-free bounded multi-producer/multi-consumer ring buffer (Vyukov)
+// Every slot carries a sequence number that tells producers and consumers whose turn it is:
+// seq == 2 * pos means the slot is free for the producer at pos,
+// seq == 2 * pos + 1 means it holds the value for the consumer at pos
+// (positions are doubled so that a one-slot ring can tell "full" from "free for the next lap")
+typedef struct {
+    atomic_size_t seq;
+    void* data;
+} mpmc_slot_t;
+
+typedef struct {
+    // consumer position
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    // producer position
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    // read-only after creation
+    _Alignas(CACHE_LINE_SIZE) size_t capacity;
+    size_t mask;            // capacity - 1 if capacity is a power of two, 0 otherwise
+    mpmc_slot_t* slots;
+} mpmc_buffer_t;
+
+// Creates a multi-producer/multi-consumer buffer with the given capacity
+mpmc_buffer_t* mpmc_buffer_create(size_t capacity);
+
+// Adds the value into the buffer; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status mpmc_buffer_add(mpmc_buffer_t* buffer, void* data);
+
+// Removes the value from the buffer in FIFO order; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
+// Returns BUFFER_ERROR otherwise
+enum buffer_status mpmc_buffer_remove(mpmc_buffer_t* buffer, void** data);
+
+// Returns true if the next add would fail because the slot is still occupied
+bool mpmc_buffer_full(mpmc_buffer_t* buffer);
+
+// Returns true if the next remove would fail because the slot has not been filled yet
+bool mpmc_buffer_empty(mpmc_buffer_t* buffer);
+
+// Frees the memory allocated to the buffer
+void mpmc_buffer_free(mpmc_buffer_t* buffer);
+
+// Returns the total capacity of the buffer
+size_t mpmc_buffer_capacity(mpmc_buffer_t* buffer);
+
+// Returns the current number of elements in the buffer (a snapshot when used concurrently)
+size_t mpmc_buffer_current_size(mpmc_buffer_t* buffer);
+
+// Lock-free bounded multi-producer/multi-consumer ring of fixed-size values, stored inline
+// Same algorithm as mpmc_buffer_t, but each cell holds its sequence number followed by elem_size
+// bytes of value, and add and remove copy values in and out, so values never need an allocation
+typedef struct {
+    // consumer position
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    // producer position
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    // read-only after creation
+    _Alignas(CACHE_LINE_SIZE) size_t capacity;
+    size_t mask;            // capacity - 1 if capacity is a power of two, 0 otherwise
+    size_t elem_size;
+    size_t stride;          // bytes per cell: the sequence number and the value, rounded up to max_align_t
+    unsigned char* cells;
+} value_buffer_t;
+
+// Creates a buffer of capacity values of elem_size bytes each
+// Returns NULL if either is 0 or memory ran out
+value_buffer_t* value_buffer_create(size_t elem_size, size_t capacity);
+
+// Copies elem_size bytes from value into the buffer; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not full and value was added
+// Returns BUFFER_ERROR otherwise
+enum buffer_status value_buffer_add(value_buffer_t* buffer, const void* value);
+
+// Copies the oldest value into value (elem_size bytes) and removes it; safe to call from any number of threads
+// Returns BUFFER_SUCCESS if the buffer is not empty and a value was removed
+// Returns BUFFER_ERROR otherwise
+enum buffer_status value_buffer_remove(value_buffer_t* buffer, void* value);
+
+// Returns true if the next add would fail because the cell is still occupied
+bool value_buffer_full(value_buffer_t* buffer);
+
+// Returns true if the next remove would fail because the cell has not been filled yet
+bool value_buffer_empty(value_buffer_t* buffer);
+
+// Frees the memory allocated to the buffer
+void value_buffer_free(value_buffer_t* buffer);
+
+// Returns the total capacity of the buffer
+size_t value_buffer_capacity(value_buffer_t* buffer);
+
+// Returns the current number of values in the buffer (a snapshot when used concurrently)
+size_t value_buffer_current_size(value_buffer_t* buffer);
+
 #endif // BUFFER_H
@@ -2,14 +2,141 @@
 // CMPSC 473 - Concurrencylab
 
 #include "channel.h"
+#include "park.h"
+#include "pool.h"
+#include "trace.h"
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+
+typedef struct SubscriberNode Subscriber;                   // Typedef for subscriber node
+
+// A thread (or one case of a select) waiting for a partner on an unbuffered channel
+typedef struct waiter {
+  struct waiter* next;
+  struct waiter* prev;
+  bool queued;                                              // Linked into the channel's sendq or recvq
+  bool done;                                                // Set by the partner that completed the hand-off
+  void* data;                                               // Value offered by a sender, or filled in for a receiver
+  int priority;                                             // A sender's priority, for CHANNEL_PRIORITY channels
+  enum channel_status status;                               // Result of the hand-off once done
+  Subscriber* select;                                       // Owning select, NULL for a plain send/receive
+  pthread_cond_t cond;                                      // A plain waiter sleeps here alone; a select sleeps on its subscriber
+  atomic_uint wake;                                         // Set to 1 to wake a plain waiter that sleeps on it
+  bool on_futex;                                            // Sleeps on wake, not cond: CHANNEL_PARK_FUTEX, or a deadline to keep
+  size_t index;                                             // Select case this waiter stands for
+  unsigned long long since;                                 // When a sender started waiting, if its channel records sojourn times (see latency_stamp)
+  struct waiter* sub_next;                                  // Links in a wait side's subscribers (select cases only)
+  struct waiter* sub_prev;
+} waiter_t;
+
+// Who may complete a blocked select: only its partners while its cases are queued (SELECT_WAITING),
+// nobody while the select runs a pass on its own (SELECT_SCANNING), and nobody once a partner won (SELECT_DONE)
+enum select_state {
+  SELECT_SCANNING,
+  SELECT_WAITING,
+  SELECT_DONE
+};
 
 struct SubscriberNode {                                     // Struct to store the subscriber node
   int signalFlag;
   pthread_mutex_t mutex;                                    // Mutex for subscriber node
   pthread_cond_t cond;                                      // Condition variable for subscriber node
+  bool timed;                                               // Waiting with a deadline, asleep on wake_seq instead of cond
+  atomic_uint wake_seq;                                     // Bumped by every signal while timed
+  atomic_int state;                                         // enum select_state
+  int completed;                                            // Set (under mutex) once the partner that won has filled in its waiter
+  size_t fired;                                             // Case completed by the partner
+  waiter_t* waiters;                                        // Rendezvous offers, one per case (unbuffered channels only)
 };
 
-typedef struct SubscriberNode Subscriber;                   // Typedef for subscriber node
+// A select whose subscriber stays registered with its channels across waits
+struct select_set {
+  select_t** entries;                                       // The caller's cases, in the order they were added
+  select_t* cases;                                          // Copy of the cases that the select code runs on
+  size_t count;
+  size_t capacity;
+  channel_t** locks;                                        // The channels of cases in select_lock_order, with capacity slots
+  size_t lock_count;
+  enum select_order order;
+  size_t next;                                              // SELECT_ROUND_ROBIN: case to scan first in the next wait
+  uint32_t seed;                                            // SELECT_RANDOM: xorshift state
+  Subscriber subscriber;                                    // Subscribed to every channel in cases; its waiters has capacity slots
+};
+
+// channel_get_stats counters. Every stats_ helper compiles to nothing when CHANNEL_STATS is 0;
+// senders and receivers only bump their own direction's counters, with relaxed atomics
+
+static void stats_init(channel_t* channel) {               // Zero every counter of a new channel
+#if CHANNEL_STATS
+    channel_counters_t* sides[] = {&channel->send_stats, &channel->recv_stats};
+    for (size_t i = 0; i < 2; i++) {
+        atomic_init(&sides[i]->ops, 0);
+        atomic_init(&sides[i]->failed, 0);
+        atomic_init(&sides[i]->blocked, 0);
+        atomic_init(&sides[i]->blocked_ns, 0);
+        atomic_init(&sides[i]->high_water, 0);
+    }
+    atomic_init(&channel->wake_stats.wakeups, 0);
+    atomic_init(&channel->wake_stats.futile_wakeups, 0);
+    atomic_init(&channel->wake_stats.select_notifications, 0);
+#endif
+}
+
+static unsigned long long clock_ns(void) {                  // CLOCK_MONOTONIC in nanoseconds, to time waits and sojourns
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000000ull + (unsigned long long) now.tv_nsec;
+}
+
+static void stats_woken(channel_t* channel, bool futile) {  // Count a parked thread waking up, and whether it still has to wait
+#if CHANNEL_STATS
+    atomic_fetch_add_explicit(&channel->wake_stats.wakeups, 1, memory_order_relaxed);
+    if (futile) {
+        atomic_fetch_add_explicit(&channel->wake_stats.futile_wakeups, 1, memory_order_relaxed);
+    }
+#endif
+}
+
+static void stats_notified(channel_t* channel, size_t selects) {   // Count selects woken by an event on the channel
+#if CHANNEL_STATS
+    if (selects > 0) {
+        atomic_fetch_add_explicit(&channel->wake_stats.select_notifications, selects, memory_order_relaxed);
+    }
+#endif
+}
+
+// What channel_attach_latency attached to a channel. Allocated by the first attach and only freed with
+// the channel, so a thread that loaded it may go on using it while another attaches other histograms
+struct channel_latency {
+    _Atomic(histogram_t*) send;                             // Recorded into without the channel mutex
+    _Atomic(histogram_t*) receive;
+    _Atomic(histogram_t*) select;
+    histogram_t* sojourn;                                   // The rest only with the channel mutex held
+    unsigned long long* stamps;                             // CHANNEL_LOCKED: send times of the newest stamp_count buffered messages,
+    size_t stamp_head;                                      // a ring of the buffer's capacity starting at stamp_head
+    size_t stamp_count;
+    size_t stamp_capacity;
+};
+
+static struct channel_latency* latency_of(channel_t* channel) {
+    return atomic_load_explicit(&channel->latency, memory_order_acquire);
+}
+
+// Returns the histogram the wait times of sends (or receives) on channel go into, or NULL if none is attached
+static histogram_t* latency_waits(channel_t* channel, enum direction dir) {
+    struct channel_latency* latency = latency_of(channel);
+    if (!latency) {
+        return NULL;
+    }
+    return atomic_load_explicit((dir == SEND) ? &latency->send : &latency->receive, memory_order_relaxed);
+}
+
+// Returns the time a sender starts waiting from, if the channel records sojourn times, and 0 otherwise (channel mutex held)
+static unsigned long long latency_stamp(channel_t* channel) {
+    struct channel_latency* latency = latency_of(channel);
+    return (latency && latency->sojourn) ? clock_ns() : 0;
+}
 
 static void set_signal_flag(Subscriber* subscriberPtr) {    // Set signal flag for subscriber node
     pthread_mutex_lock(&subscriberPtr->mutex);              // Lock subscriber node mutex
@@ -17,9 +144,18 @@ static void set_signal_flag(Subscriber* subscriberPtr) {    // Set signal flag f
     pthread_mutex_unlock(&subscriberPtr->mutex);            // Unlock subscriber node mutex
 }
 
+static void subscriber_wake(Subscriber* subscriberPtr) {        // Wake the select sleeping on a subscriber node (its mutex held)
+    if (subscriberPtr->timed) {
+        atomic_fetch_add(&subscriberPtr->wake_seq, 1);
+        park_wake(&subscriberPtr->wake_seq, 1);
+    } else {
+        pthread_cond_signal(&subscriberPtr->cond);
+    }
+}
+
 static void signal_condition(Subscriber* subscriberPtr) {       // Signal subscriber condition variable
     pthread_mutex_lock(&subscriberPtr->mutex);                  //  Lock subscriber node mutex
-    pthread_cond_signal(&subscriberPtr->cond);                  //  Signal subscriber condition variable
+    subscriber_wake(subscriberPtr);                             //  Signal subscriber condition variable
     pthread_mutex_unlock(&subscriberPtr->mutex);                //  Unlock subscriber node mutex
 }
 
@@ -29,260 +165,1388 @@ static void SignalSubscriber(void* data) {                     // Inform (unbloc
     signal_condition(subscriberPtr);                           // Signal subscriber condition variable
 }
 
-static void subscriber_wait(Subscriber *subscriberPtr) {
- 
-  pthread_mutex_lock(&subscriberPtr->mutex);                         // Lock the mutex    
-
-  // Wait until an event on list
-  do {
-    pthread_cond_wait(&subscriberPtr->cond, &subscriberPtr->mutex);   // Wait on condition variable
-  } while(subscriberPtr->signalFlag == 0);                            
-
-  pthread_mutex_unlock(&subscriberPtr->mutex);                       // Unlock the mutex
+static size_t signal_subscribers(wait_side_t* side) {         // Inform every select waiting for this side (channel mutex held); returns how many
+  size_t count = 0;
+  for (waiter_t* node = side->subscribers; node; node = node->sub_next) {
+    SignalSubscriber(node->select);
+    count++;
+  }
+  return count;
 }
 
-// Creates a new channel with the provided size and returns it to the caller
-// A 0 size indicates an unbuffered channel, whereas a positive size indicates a buffered channel
+static void waitq_push(waitq_t* queue, waiter_t* waiter) {     // Append a waiter (FIFO)
+  waiter->next = NULL;
+  waiter->prev = queue->tail;
+  if (queue->tail) {
+    queue->tail->next = waiter;
+  } else {
+    queue->head = waiter;
+  }
+  queue->tail = waiter;
+  waiter->queued = true;
+}
 
-static Subscriber* subscriber_create(select_t *channel_list, size_t channel_count) {
-   
-    Subscriber *subscriberPtr = (Subscriber*) calloc(1, sizeof(Subscriber));      // Allocate memory for subscriber node
-    if (!subscriberPtr) return NULL;                                              // Return NULL if allocation fails  
+static void waitq_unlink(waitq_t* queue, waiter_t* waiter) {   // Remove a waiter from anywhere in the queue
+  if (waiter->prev) {
+    waiter->prev->next = waiter->next;
+  } else {
+    queue->head = waiter->next;
+  }
+  if (waiter->next) {
+    waiter->next->prev = waiter->prev;
+  } else {
+    queue->tail = waiter->prev;
+  }
+  waiter->next = waiter->prev = NULL;
+  waiter->queued = false;
+}
 
-    if (pthread_mutex_init(&subscriberPtr->mutex, NULL) != 0) {                   // Initialize mutex
-        free(subscriberPtr);                                                      // Free subscriber node if mutex initialization fails
-        return NULL;                                                              // Return NULL if mutex initialization fails
+// Dequeues the first waiter the caller is allowed to complete
+// A select offer is only taken if the select is still parked; this claims the whole select,
+// so none of its other offers can fire. Offers of a select that is busy elsewhere are dropped;
+// the select queues them again before it parks.
+static waiter_t* waitq_pop_claimable(waitq_t* queue) {
+  waiter_t* waiter;
+  while ((waiter = queue->head) != NULL) {
+    waitq_unlink(queue, waiter);
+    if (waiter->select == NULL) {
+      return waiter;
     }
-    if (pthread_cond_init(&subscriberPtr->cond, NULL) != 0) {                     // Initialize condition variable
-        pthread_mutex_destroy(&subscriberPtr->mutex);                             // Destroy mutex if condition variable initialization fails
-        free(subscriberPtr);                                                      // Free subscriber node if condition variable initialization fails
-        return NULL;
+    int expected = SELECT_WAITING;
+    if (atomic_compare_exchange_strong(&waiter->select->state, &expected, SELECT_DONE)) {
+      return waiter;
     }
+  }
+  return NULL;
+}
 
-  // Iterate over each channel
+#define SPIN_MIN 16                                         // CHANNEL_WAIT_SPIN budget bounds, in park_relax rounds
+#define SPIN_MAX 4096
+#define POLL_YIELD 16                                       // CHANNEL_WAIT_POLL rounds between sched_yield calls
 
-    for (size_t i = 0; i < channel_count; ++i) {                      
-        select_t *sel = &channel_list[i];
-        if (pthread_mutex_lock(&sel->channel->mutex) != 0) continue;              // Lock the mutex before modifying the channel
-        list_insert(sel->channel->subscribers, (void*)subscriberPtr);             // Insert subscriber node into the list
-        pthread_mutex_unlock(&sel->channel->mutex);                               // Unlock the mutex after modifying the channel
-    }
+// A word a spinning thread watches until it no longer holds the value it saw
+typedef struct {
+  atomic_uint* word;
+  unsigned int seen;
+} spin_word_t;
 
-    return subscriberPtr;
+static bool spin_word_changed(channel_t* channel, void* arg) {
+  (void)channel;
+  spin_word_t* watch = arg;
+  return atomic_load(watch->word) != watch->seen;
 }
 
-static void subscriber_destroy(select_t * channel_list, size_t channel_count, Subscriber * subscriberPtr){
-  
-  for(size_t i = 0; i < channel_count; ++i){
-    select_t * sel = &channel_list[i];
-    pthread_mutex_lock(&sel->channel->mutex);                               //  Lock the mutex before modifying the channel
-    list_node_t* node = list_find(sel->channel->subscribers, (void*)subscriberPtr);     // Find subscriber node in the list
-    
-    if(node != NULL){                                                       // If subscriber node is found in the list
-      list_remove(sel->channel->subscribers, node);                         // Remove subscriber node from the list
-      free(node);
+// Busy-waits (without the channel mutex) until ready(channel, arg) holds
+// Returns true if it did, and false if the channel parks right away, the spin budget ran out or deadline passed
+// CHANNEL_WAIT_SPIN adapts the budget: a spin that succeeded leaves room for twice as long next
+// time, and one that ran out halves it, so links whose partner keeps up spin and the others park.
+static bool wait_spin(channel_t* channel, bool (*ready)(channel_t*, void*), void* arg, const struct timespec* deadline) {
+  if (channel->wait == CHANNEL_WAIT_BLOCK) {
+    return false;
+  }
+  if (channel->wait == CHANNEL_WAIT_POLL) {
+    for (unsigned int i = 1; !ready(channel, arg); i++) {
+      park_relax();
+      if (i % POLL_YIELD == 0) {
+        sched_yield();                                      // Let the partner run if it shares our core
+        if (park_deadline_passed(deadline)) {
+          return false;
+        }
+      }
     }
-    
-    pthread_mutex_unlock(&sel->channel->mutex);                             // Unlock the mutex after modifying the channel
+    return true;
   }
-  
-  pthread_mutex_destroy(&subscriberPtr->mutex);                           //  Destroy mutex
-  pthread_cond_destroy(&subscriberPtr->cond);                             //  Destroy condition variable
-  free(subscriberPtr);                                                    //  Free subscriber node    
+  unsigned int budget = atomic_load(&channel->spin);
+  for (unsigned int i = 0; i < budget; i++) {
+    if (ready(channel, arg)) {
+      if (2 * i > budget) {
+        atomic_store(&channel->spin, 2 * budget < SPIN_MAX ? 2 * budget : SPIN_MAX);
+      }
+      return true;
+    }
+    park_relax();
+  }
+  atomic_store(&channel->spin, budget / 2 > SPIN_MIN ? budget / 2 : SPIN_MIN);
+  return false;
 }
 
-channel_t* channel_create(size_t size)                                  
-{
-    if(size <= 0){                                                  // If size is less than or equal to 0
-        fprintf(stderr, "Invalid size\n");                          // Print error message
-      exit(1);    
+// Wakes a plain waiter (channel mutex held)
+// The waiter may be spinning on wake without the mutex, so wake is set last on the condvar path:
+// once it sees wake the waiter may destroy its cond. With futexes the waiter may see wake and
+// return before park_wake runs; waking its old stack slot is harmless, since every park_wait
+// caller re-checks its condition.
+static void waiter_wake(channel_t* channel, waiter_t* waiter) {
+  (void)channel;
+  if (waiter->on_futex) {
+    atomic_store(&waiter->wake, 1);
+    park_wake(&waiter->wake, 1);
+  } else {
+    pthread_cond_signal(&waiter->cond);
+    atomic_store(&waiter->wake, 1);
+  }
+}
+
+// Finishes a hand-off for a dequeued waiter and wakes its owner, and nobody else (channel mutex held)
+static void waiter_complete(channel_t* channel, waiter_t* waiter, enum channel_status status) {
+  TRACE(TRACE_WAKE, channel, status);
+  waiter->status = status;
+  waiter->done = true;
+  if (waiter->select) {
+    Subscriber* subscriberPtr = waiter->select;
+    pthread_mutex_lock(&subscriberPtr->mutex);
+    subscriberPtr->fired = waiter->index;
+    subscriberPtr->completed = 1;
+    subscriberPtr->signalFlag = 1;
+    subscriber_wake(subscriberPtr);
+    pthread_mutex_unlock(&subscriberPtr->mutex);
+    stats_notified(channel, 1);
+  } else {
+    waiter_wake(channel, waiter);
+  }
+}
+
+// Blocks a plain waiter until a partner completes it, the channel closes or deadline passes (channel mutex held)
+// Returns true once completed, with the channel mutex released,
+// and false if the channel closed or the deadline passed first, with the channel mutex still held
+// A waiter with a deadline sleeps on its futex word whatever the channel's park mode: condition variables are never timed
+static bool waiter_park(channel_t* channel, waiter_t* self, const struct timespec* deadline) {
+  spin_word_t watch = {&self->wake, 0};
+  self->on_futex = channel->park == CHANNEL_PARK_FUTEX || deadline != NULL;     // Wakers read it under the mutex we hold
+  if (self->on_futex) {
+    pthread_mutex_unlock(&channel->mutex);
+    wait_spin(channel, spin_word_changed, &watch, deadline);
+    bool in_time = true;
+    while (atomic_load(&self->wake) == 0 && in_time) {
+      in_time = park_wait_until(&self->wake, 0, deadline);
+      if (in_time) {
+        stats_woken(channel, atomic_load(&self->wake) == 0);
+      }
+    }
+    if (atomic_load(&self->wake) && self->done) {
+      return true;                                          // The partner filled in self before setting wake
+    }
+    pthread_mutex_lock(&channel->mutex);
+    if (self->done) {                                       // Completed just as the deadline passed
+      pthread_mutex_unlock(&channel->mutex);
+      return true;
     }
+    return false;
+  }
+  pthread_cond_init(&self->cond, NULL);
+  if (channel->wait != CHANNEL_WAIT_BLOCK) {
+    pthread_mutex_unlock(&channel->mutex);
+    bool woken = wait_spin(channel, spin_word_changed, &watch, deadline);
+    if (woken && self->done) {
+      pthread_cond_destroy(&self->cond);                    // The partner is done with us and cond
+      return true;
+    }
+    pthread_mutex_lock(&channel->mutex);
+  }
+  while (!self->done && !channel->end_flag) {
+    pthread_cond_wait(&self->cond, &channel->mutex);        // Only our partner (or close) wakes us
+    stats_woken(channel, !self->done && !channel->end_flag);
+  }
+  pthread_cond_destroy(&self->cond);
+  if (self->done) {
+    pthread_mutex_unlock(&channel->mutex);
+    return true;
+  }
+  return false;
+}
 
-    channel_t* channel = (channel_t*) malloc(sizeof(channel_t));          // Allocate memory for channel
-    
+// Wakes every waiter so it notices the channel closed (channel mutex held)
+// Plain waiters unlink themselves; queued select cases are completed with CLOSED_ERROR here
+static void waitq_wake_all(channel_t* channel, waitq_t* queue) {
+  waiter_t* waiter = queue->head;
+  while (waiter) {
+    waiter_t* next = waiter->next;
+    if (waiter->select == NULL) {
+      waiter_wake(channel, waiter);
+    } else {
+      waitq_unlink(queue, waiter);
+      int expected = SELECT_WAITING;
+      if (atomic_compare_exchange_strong(&waiter->select->state, &expected, SELECT_DONE)) {
+        waiter_complete(channel, waiter, CLOSED_ERROR);
+      }
+    }
+    waiter = next;
+  }
+}
 
-    if (!channel || 
-        !(channel->buffer = buffer_create(size)) ||                               // Allocate memory for buffer
-        pthread_mutex_init(&(channel->mutex), NULL) != 0 ||                       // Initialize mutex
-        pthread_cond_init(&(channel->cond), NULL) != 0 ||                         // Initialize condition variable
-        !(channel->subscribers = list_create()))                                // Create list                    
-    {
-        if(!channel) perror("malloc");
-        else if(!(channel->buffer)) perror("buffer_create");               
-        else if(pthread_mutex_init(&(channel->mutex), NULL) != 0) perror("pthread_mutex_init");     
-        else if(pthread_cond_init(&(channel->cond), NULL) != 0) perror("pthread_cond_init");
-        else perror("list_create");                                             // Print error message
+static void side_wake_all(channel_t* channel, wait_side_t* side) {   // Wake everybody on one side, blocked or parked
+  atomic_fetch_add(&side->seq, 1);
+  if (channel->park == CHANNEL_PARK_FUTEX || atomic_load(&side->timed_waiters) > 0) {
+    park_wake_all(&side->seq);
+  }
+  if (channel->park == CHANNEL_PARK_COND) {
+    pthread_cond_broadcast(&side->cond);
+  }
+}
 
-        if(channel) {
-            if(channel->buffer) free(channel->buffer);                          //  Free buffer
-            free(channel);
-        }
+// Waits until a partner completes a case or a lock-free channel signals, or until deadline passes
+// Returns false if nothing happened before the deadline
+// With a deadline the select sleeps on wake_seq, since condition variables are never timed
+static bool subscriber_wait(Subscriber *subscriberPtr, const struct timespec* deadline) {
+ 
+  pthread_mutex_lock(&subscriberPtr->mutex);                         // Lock the mutex    
 
-        exit(EXIT_FAILURE);
+  // Wait until an event on list; events that arrived since the last pass count too
+  subscriberPtr->timed = deadline != NULL;                           // Signallers read it under the mutex we hold
+  while(subscriberPtr->signalFlag == 0) {
+    if (!deadline) {
+      pthread_cond_wait(&subscriberPtr->cond, &subscriberPtr->mutex);   // Wait on condition variable
+      continue;
+    }
+    unsigned int seen = atomic_load(&subscriberPtr->wake_seq);       // Any signal from here on changes wake_seq
+    pthread_mutex_unlock(&subscriberPtr->mutex);
+    bool in_time = park_wait_until(&subscriberPtr->wake_seq, seen, deadline);
+    pthread_mutex_lock(&subscriberPtr->mutex);
+    if (!in_time) {
+      break;
     }
+  }
+  subscriberPtr->timed = false;
+  bool signalled = subscriberPtr->signalFlag != 0;
+  subscriberPtr->signalFlag = 0;                                      // Consume the event before the next pass
 
-    channel->end_flag = 0;                            // Set end flag to 0  
+  pthread_mutex_unlock(&subscriberPtr->mutex);                       // Unlock the mutex
+  return signalled;
+}
 
-    return channel; 
+static bool is_lockfree(channel_t* channel) {
+    return channel->kind == CHANNEL_SPSC || channel->kind == CHANNEL_MPMC || channel->kind == CHANNEL_TYPED;
 }
 
-// Writes data to the given channel
-// This is a blocking call i.e., the function only returns on a successful completion of send
-// In case the channel is full, the function waits till the channel has space to write the new data
-// Returns SUCCESS for successfully writing data to the channel,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
+// Selects wait on a channel in one of two ways. Locked and unbuffered channels have sendq and recvq:
+// a select queues one waiter per case there, and the partner that takes it completes the case
+// directly. Lock-free channels have no queues, so a select subscribes to the side of the channel each
+// case waits for instead; a send signals the RECV subscribers and a receive the SEND subscribers
+// (see lockfree_notify), and the select makes another pass.
 
-enum channel_status channel_send(channel_t *channel, void* data) {      
-    if (pthread_mutex_lock(&channel->mutex) != 0) {     // Lock the mutex before modifying the channel
-        return GEN_ERROR;
-    }
+static wait_side_t* subscriber_side(select_t* sel) {        // The side a case waits for: space to send or data to receive
+    return (sel->dir == SEND) ? &sel->channel->not_full : &sel->channel->not_empty;
+}
 
-    if (channel->end_flag) {                                                // If channel is closed
-        pthread_mutex_unlock(&channel->mutex);                              // Unlock the mutex after modifying the channel
-        return CLOSED_ERROR;
+// Subscribes one select case to the side of its channel it waits for, if the channel is lock-free
+// The node is the case's own waiter, so this is O(1) and never allocates
+static void subscriber_register(select_t* sel, waiter_t* node) {
+    channel_t* channel = sel->channel;
+    if (!is_lockfree(channel)) {
+        return;                                                                   // The select queues node on sendq or recvq instead
     }
-
-    while (buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer) && !channel->end_flag) {
-        pthread_cond_wait(&channel->cond, &channel->mutex);                             // Wait on condition variable
+    wait_side_t* side = subscriber_side(sel);
+    pthread_mutex_lock(&channel->mutex);                                          // Lock the mutex before modifying the channel
+    node->sub_prev = NULL;                                                        // Prepend to the side's subscribers
+    node->sub_next = side->subscribers;
+    if (side->subscribers) {
+        side->subscribers->sub_prev = node;
     }
+    side->subscribers = node;
+    atomic_fetch_add(&side->waiters, 1);                                          // Operations on this side must now notify us (see lockfree_notify)
+    atomic_exchange(&side->wake_pending, false);
+    pthread_mutex_unlock(&channel->mutex);                                        // Unlock the mutex after modifying the channel
+}
 
-    if (channel->end_flag) {                                                //  If channel is closed
-        pthread_mutex_unlock(&channel->mutex);                              // Unlock the mutex after modifying the channel
-        return CLOSED_ERROR;                                                // Return CLOSED_ERROR if channel is closed
+static void subscribers_unlink(wait_side_t* side, waiter_t* node) {              // Take a node out of the side's subscribers (channel mutex held)
+    if (node->sub_prev) {
+        node->sub_prev->sub_next = node->sub_next;
+    } else {
+        side->subscribers = node->sub_next;
     }
-
-    enum channel_status sn = buffer_add(channel->buffer, data) == BUFFER_SUCCESS ? SUCCESS : GEN_ERROR;     // Add data to buffer
-
-    if (sn == SUCCESS) {
-        pthread_cond_broadcast(&channel->cond);                                   // Signal all threads waiting on condition variable
-        list_foreach(channel->subscribers, SignalSubscriber);                     // Signal all subscribers
+    if (node->sub_next) {
+        node->sub_next->sub_prev = node->sub_prev;
     }
+}
 
-    pthread_mutex_unlock(&channel->mutex);                                        //  Unlock the mutex after modifying the channel
+static void subscriber_unregister(select_t* sel, waiter_t* node) {               // Undoes subscriber_register, also O(1)
+    channel_t* channel = sel->channel;
+    if (!is_lockfree(channel)) {
+        return;
+    }
+    wait_side_t* side = subscriber_side(sel);
+    pthread_mutex_lock(&channel->mutex);
+    subscribers_unlink(side, node);
+    atomic_fetch_sub(&side->waiters, 1);                                          // No longer waiting on this side
+    pthread_mutex_unlock(&channel->mutex);
+}
 
-    return sn;
+// Moves a case's waiter to new memory, keeping its place among the side's subscribers
+// Only valid between waits, while no waiter of the select is queued
+static void subscriber_move(select_t* sel, waiter_t* from, waiter_t* to) {
+    channel_t* channel = sel->channel;
+    if (!is_lockfree(channel)) {
+        *to = *from;
+        return;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    *to = *from;
+    if (to->sub_prev) {
+        to->sub_prev->sub_next = to;
+    } else {
+        subscriber_side(sel)->subscribers = to;
+    }
+    if (to->sub_next) {
+        to->sub_next->sub_prev = to;
+    }
+    pthread_mutex_unlock(&channel->mutex);
 }
 
+// Sets up a select over channel_list, with one waiter per case in waiters, and subscribes it to the lock-free channels
+// Returns false if the subscriber's mutex or condition variable could not be initialized
+static bool subscriber_init(Subscriber* subscriberPtr, waiter_t* waiters, select_t *channel_list, size_t channel_count) {
 
-// Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
-// This is a blocking call i.e., the function only returns on a successful completion of receive
-// In case the channel is empty, the function waits till the channel has some data to read
-// Returns SUCCESS for successful retrieval of data,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
+    if (pthread_mutex_init(&subscriberPtr->mutex, NULL) != 0) {                   // Initialize mutex
+        return false;                                                             // Return false if mutex initialization fails
+    }
+    if (pthread_cond_init(&subscriberPtr->cond, NULL) != 0) {                     // Initialize condition variable
+        pthread_mutex_destroy(&subscriberPtr->mutex);                             // Destroy mutex if condition variable initialization fails
+        return false;
+    }
 
-enum channel_status channel_receive(channel_t* channel, void** data)
-{
-  enum channel_status rv = SUCCESS;
-  int lockStatus = pthread_mutex_lock(&channel->mutex);        // lock the channel
+    subscriberPtr->signalFlag = 0;
+    subscriberPtr->timed = false;
+    atomic_init(&subscriberPtr->wake_seq, 0);
+    subscriberPtr->completed = 0;
+    subscriberPtr->fired = 0;
+    subscriberPtr->waiters = waiters;
+    atomic_init(&subscriberPtr->state, SELECT_SCANNING);                         // Not claimable until its cases are queued
 
-  if(lockStatus != 0){                                         // check if the lock was successful
-    return GEN_ERROR;                                          // return error if lock failed 
-  }
+  // Iterate over each channel
 
-  do{
-    if(channel->end_flag){                                     // check if the channel is closed
-      rv = CLOSED_ERROR;                                       // return error, if channel is closed
-      break;                                                   // break from the loop
+    for (size_t i = 0; i < channel_count; ++i) {
+        waiters[i] = (waiter_t) {.select = subscriberPtr, .index = i};
+        subscriber_register(&channel_list[i], &waiters[i]);
     }
 
-    //wait while the buffer is empty
-    while(  (buffer_current_size(channel->buffer) == 0) &&     // check if the buffer is empty
-            (channel->end_flag == 0) ){                        // check if the channel is closed
-      pthread_cond_wait(&channel->cond, &channel->mutex);      // wait for a signal that the buffer is not empty
+    return true;
+}
+
+// Forgets earlier events and asks lock-free channels to notify us again, before a pass over the cases
+static void subscriber_rearm(select_t *channel_list, size_t channel_count, Subscriber *subscriberPtr) {
+    pthread_mutex_lock(&subscriberPtr->mutex);
+    subscriberPtr->signalFlag = 0;                                          // Anything from here on is seen by the pass or signals again
+    subscriberPtr->completed = 0;
+    pthread_mutex_unlock(&subscriberPtr->mutex);
+    for (size_t i = 0; i < channel_count; ++i) {
+        if (is_lockfree(channel_list[i].channel)) {
+            atomic_exchange(&subscriber_side(&channel_list[i])->wake_pending, false);
+        }
     }
+}
 
-    if(channel->end_flag){                                     // check if the channel is closed
-      rv = CLOSED_ERROR;                                       // return error, if channel is closed
-      break;                                                   // break from the loop
+// Queues a waiter for every case on a locked or unbuffered channel and makes the select claimable
+// (every channel mutex held, so no partner can see only some of the cases)
+static void subscriber_enqueue(select_t *channel_list, size_t channel_count, Subscriber *subscriberPtr) {
+    atomic_store(&subscriberPtr->state, SELECT_WAITING);
+    for (size_t i = 0; i < channel_count; ++i) {
+        select_t *sel = &channel_list[i];
+        waiter_t *offer = &subscriberPtr->waiters[i];
+        if (is_lockfree(sel->channel)) continue;
+        offer->done = false;
+        offer->data = (sel->dir == SEND) ? sel->data : NULL;
+        offer->priority = sel->priority;
+        offer->since = (sel->dir == SEND) ? latency_stamp(sel->channel) : 0;
+        waitq_push(sel->dir == SEND ? &sel->channel->sendq : &sel->channel->recvq, offer);
     }
+}
 
-    if(buffer_remove(channel->buffer, data) != BUFFER_SUCCESS){ //get data from channel
-      rv = GEN_ERROR;                                           //return error, if remove failed
-      break;
+// Takes the select back from its partners once it woke up
+// Returns false if a partner already completed one of its cases
+static bool subscriber_withdraw(Subscriber *subscriberPtr) {
+    int expected = SELECT_WAITING;
+    if (atomic_compare_exchange_strong(&subscriberPtr->state, &expected, SELECT_SCANNING)) {
+        return true;
+    }
+    pthread_mutex_lock(&subscriberPtr->mutex);                              // The partner may still be filling in its waiter
+    while (!subscriberPtr->completed) {
+        pthread_cond_wait(&subscriberPtr->cond, &subscriberPtr->mutex);
     }
+    pthread_mutex_unlock(&subscriberPtr->mutex);
+    return false;
+}
 
-    pthread_cond_broadcast(&channel->cond);                    // tell waiting threads data was removed
+// Unlinks the waiters nobody took (every channel mutex held), so the cases can change before the next wait
+static void subscriber_retract(select_t *channel_list, size_t channel_count, Subscriber *subscriberPtr) {
+  for(size_t i = 0; i < channel_count; ++i){
+    select_t * sel = &channel_list[i];
+    waiter_t* offer = &subscriberPtr->waiters[i];
+    if(offer->queued){
+      waitq_unlink(sel->dir == SEND ? &sel->channel->sendq : &sel->channel->recvq, offer);
+    }
+  }
+}
 
-    list_foreach(channel->subscribers, SignalSubscriber);      // tell each subscriber we have event on this list
+static void subscriber_destroy(select_t * channel_list, size_t channel_count, Subscriber * subscriberPtr){
 
-  }while(0);                                                   // end of do-while loop
+  for(size_t i = 0; i < channel_count; ++i){
+    subscriber_unregister(&channel_list[i], &subscriberPtr->waiters[i]);
+  }
 
-  pthread_mutex_unlock(&channel->mutex);                       // unlock the mutex before signalling the subscribers
+  pthread_mutex_destroy(&subscriberPtr->mutex);                           //  Destroy mutex
+  pthread_cond_destroy(&subscriberPtr->cond);                             //  Destroy condition variable
+}
 
-  return rv;                                                   // return the status
+// Sets up everything but the storage backend of a channel whose memory the caller provides
+// Returns false if the mutex or a condition variable could not be initialized (nothing is left to clean up then)
+static bool channel_init(channel_t* channel, const channel_attr_t* attr, bool in_array)
+{
+    channel->kind = attr->kind;
+    channel->park = attr->park;
+    channel->wait = attr->wait;
+    channel->in_array = in_array;
+    atomic_init(&channel->spin, SPIN_MIN * 8);                                 // Adapted by wait_spin from here on
+
+    if (pthread_mutex_init(&(channel->mutex), NULL) != 0) {                       // Initialize mutex
+        perror("pthread_mutex_init");
+        return false;
+    }
+    if (pthread_cond_init(&(channel->not_full.cond), NULL) != 0) {                // Initialize condition variables
+        perror("pthread_cond_init");
+        goto destroy_mutex;
+    }
+    if (pthread_cond_init(&(channel->not_empty.cond), NULL) != 0) {
+        perror("pthread_cond_init");
+        goto destroy_not_full;
+    }
+    channel->not_full.subscribers = NULL;                                       // No select subscribed yet
+    channel->not_empty.subscribers = NULL;
+
+    atomic_init(&channel->end_flag, 0);                                         // Set end flag to 0
+    channel->sendq = (waitq_t) {NULL, NULL};                                    // No senders or receivers parked
+    channel->recvq = (waitq_t) {NULL, NULL};
+    atomic_init(&channel->not_full.waiters, 0);
+    atomic_init(&channel->not_empty.waiters, 0);
+    atomic_init(&channel->not_full.wake_pending, false);
+    atomic_init(&channel->not_empty.wake_pending, false);
+    atomic_init(&channel->not_full.seq, 0);
+    atomic_init(&channel->not_empty.seq, 0);
+    atomic_init(&channel->not_full.timed_waiters, 0);
+    atomic_init(&channel->not_empty.timed_waiters, 0);
+    stats_init(channel);
+    atomic_init(&channel->latency, NULL);
+    return true;
+
+destroy_not_full:
+    pthread_cond_destroy(&channel->not_full.cond);
+destroy_mutex:
+    pthread_mutex_destroy(&channel->mutex);
+    return false;
 }
 
+// Undoes channel_init
+static void channel_fini(channel_t* channel)
+{
+    struct channel_latency* latency = atomic_load(&channel->latency);
+    if (latency) {
+        free(latency->stamps);
+        free(latency);
+    }
+    pthread_cond_destroy(&channel->not_full.cond);                              // Destroy the condition variables
+    pthread_cond_destroy(&channel->not_empty.cond);
+    pthread_mutex_destroy(&channel->mutex);                                     // Destroy the mutex
+}
 
-// Writes data to the given channel
-// This is a non-blocking call i.e., the function simply returns if the channel is full
-// Returns SUCCESS for successfully writing data to the channel,
-// CHANNEL_FULL if the channel is full and the data was not added to the buffer,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
+static void channel_free_backend(channel_t* channel)
+{
+    if (channel->buffer) buffer_free(channel->buffer);                          //  Free buffer
+    if (channel->spsc) spsc_buffer_free(channel->spsc);                         //  Free the lock-free ring
+    if (channel->mpmc) mpmc_buffer_free(channel->mpmc);
+    if (channel->typed) value_buffer_free(channel->typed);
+}
 
-enum channel_status channel_non_blocking_send(channel_t* channel, void* data) {
-  
-    // Attempt to lock the channel. On failure, return general error
-    if(pthread_mutex_lock(&channel->mutex) != 0){                       // lock the channel
-        return GEN_ERROR;                                               // return error if lock failed
+static channel_t* channel_alloc(const channel_attr_t* attr)
+{
+    channel_t* channel = (channel_t*) aligned_alloc(CACHE_ALIGNMENT, sizeof(channel_t));   // Whole cache lines of its own
+    if (!channel) {
+        perror("malloc");
+        return NULL;
     }
 
-    // If the channel is closed, unlock the mutex and return closed error
-    if(channel->end_flag){                                              // check if the channel is closed
-        pthread_mutex_unlock(&channel->mutex);                          // unlock the mutex before signalling the subscribers
-        return CLOSED_ERROR;                                            // return error, if channel is closed
+    enum channel_kind kind = attr->kind;
+    size_t size = attr->size;
+    channel->buffer = NULL;
+    channel->spsc = NULL;
+    channel->mpmc = NULL;
+    channel->typed = NULL;
+
+    if (kind == CHANNEL_SPSC) {
+        channel->spsc = spsc_buffer_create(size);                               // Allocate the lock-free ring
+    } else if (kind == CHANNEL_MPMC) {
+        channel->mpmc = mpmc_buffer_create(size);
+    } else if (kind == CHANNEL_TYPED) {
+        channel->typed = value_buffer_create(attr->elem_size, size);
+    } else if (kind == CHANNEL_LOCKED) {
+        channel->buffer = buffer_create_pow2(size);                             // Counter-indexed ring, no wrap-around branches
+    } else if (kind == CHANNEL_UNBOUNDED) {
+        channel->buffer = buffer_create_unbounded(size);                        // Only the first segment for now
+    } else if (kind == CHANNEL_PRIORITY) {
+        channel->buffer = buffer_create_priority(size);
     }
 
-    // If the buffer is full, unlock the mutex and return channel full error
-    if(buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer)){  // check if the buffer is full
-        pthread_mutex_unlock(&channel->mutex);                                     // unlock the mutex before signalling the subscribers
-        return CHANNEL_FULL;                                                       // return error, if channel is full
+    if (kind != CHANNEL_UNBUFFERED && !channel->buffer && !channel->spsc && !channel->mpmc && !channel->typed) {
+        perror("buffer_create");
+        free(channel);
+        return NULL;
+    }
+    if (!channel_init(channel, attr, false)) {
+        channel_free_backend(channel);
+        free(channel);
+        return NULL;
     }
+    return channel;
+}
 
-    // Try to add data to buffer, on failure unlock mutex and return general error
-    if(buffer_add(channel->buffer, data) != BUFFER_SUCCESS){                       // add data to channel
-        pthread_mutex_unlock(&channel->mutex);                                     // unlock the mutex before signalling the subscribers
-        return GEN_ERROR;                                                          // return error, if add failed
+channel_t* channel_create(size_t size)                                  
+{
+    channel_t* channel = channel_alloc(&(channel_attr_t) {size == 0 ? CHANNEL_UNBUFFERED : CHANNEL_LOCKED, size, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK});
+    if (!channel) {
+        exit(EXIT_FAILURE);
     }
 
-    // If data added successfully, broadcast condition variable and signal subscribers
-    pthread_cond_broadcast(&channel->cond);                             // tell waiting threads data was inserted
-    list_foreach(channel->subscribers, SignalSubscriber);               // tell each subscriber we have event on this list
+    return channel; 
+}
 
-    // Finally unlock the mutex and return success
-    pthread_mutex_unlock(&channel->mutex);                              // unlock the mutex before signalling the subscribers
+// Creates a new single-producer/single-consumer channel with the provided (positive) size
+// Returns NULL if the size is 0 or the channel could not be allocated
+channel_t* channel_create_spsc(size_t size)
+{
+    if (size == 0) {                                                // The ring needs at least one slot
+        return NULL;
+    }
+    return channel_alloc(&(channel_attr_t) {CHANNEL_SPSC, size, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK});
+}
 
-    return SUCCESS;
+// Creates a new multi-producer/multi-consumer channel with the provided (positive) size
+// Returns NULL if the size is 0 or the channel could not be allocated
+channel_t* channel_create_mpmc(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+    return channel_alloc(&(channel_attr_t) {CHANNEL_MPMC, size, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK});
 }
 
-// Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
-// This is a non-blocking call i.e., the function simply returns if the channel is empty
-// Returns SUCCESS for successful retrieval of data,
-// CHANNEL_EMPTY if the channel is empty and nothing was stored in data,
-// CLOSED_ERROR if the channel is closed, and
-// GEN_ERROR on encountering any other generic error of any sort
+// Creates a new channel with no capacity limit
+// Returns NULL if the channel could not be allocated
+channel_t* channel_create_unbounded(void)
+{
+    return channel_alloc(&(channel_attr_t) {CHANNEL_UNBOUNDED, CHANNEL_SEGMENT_SIZE, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK});
+}
 
-enum channel_status handleError(pthread_mutex_t* mutex, enum channel_status error) {   // Function to handle errors
-    pthread_mutex_unlock(mutex);                                                       // Unlock the mutex
-    return error;
+// Creates a new priority channel with the provided (positive) size
+// Returns NULL if the size is 0 or the channel could not be allocated
+channel_t* channel_create_priority(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+    return channel_alloc(&(channel_attr_t) {CHANNEL_PRIORITY, size, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK});
 }
 
-enum channel_status handleSuccess(pthread_mutex_t* mutex, pthread_cond_t* cond, list_t* subscribers) {      // Function to handle success
-    pthread_cond_broadcast(cond);                                                                           // Broadcast the condition variable
-    list_foreach(subscribers, SignalSubscriber);                                                            // Signal the subscribers
-    pthread_mutex_unlock(mutex);                                                                            // Unlock the mutex
-    return SUCCESS;                                                                                         // Return success
+// Creates a new channel of capacity values of elem_size bytes each
+// Returns NULL if either is 0 or the channel could not be allocated
+channel_t* channel_create_typed(size_t elem_size, size_t capacity)
+{
+    if (elem_size == 0 || capacity == 0) {
+        return NULL;
+    }
+    return channel_alloc(&(channel_attr_t) {CHANNEL_TYPED, capacity, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK, elem_size});
 }
 
-enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
+// Creates a new channel as described by attr
+// Returns NULL if attr is invalid or the channel could not be allocated
+channel_t* channel_create_with_attr(const channel_attr_t* attr)
 {
-    if (pthread_mutex_lock(&channel->mutex) != 0){                                                          // Lock the mutex
-        return GEN_ERROR;
+    if (!attr || attr->kind > CHANNEL_TYPED || attr->park > CHANNEL_PARK_FUTEX || attr->wait > CHANNEL_WAIT_POLL) {
+        return NULL;
+    }
+    if ((attr->size == 0) != (attr->kind == CHANNEL_UNBUFFERED)) {  // Only an unbuffered channel has no slots
+        return NULL;
     }
+    if (attr->kind == CHANNEL_TYPED && attr->elem_size == 0) {
+        return NULL;
+    }
+    return channel_alloc(attr);
+}
 
-    if(channel->end_flag){
+// Lock-free channels (CHANNEL_SPSC, CHANNEL_MPMC and CHANNEL_TYPED)
+// The ring itself needs no lock. The mutex and the not_full/not_empty sides are only used to park
+// a thread when the ring is full (sender) or empty (receiver), and by channel_close to wake them up.
+// A thread that parks first increments its side's waiters and then re-checks the ring; a thread that
+// changes the ring first updates it and then reads waiters with a read-modify-write. Both
+// RMWs are totally ordered on waiters, so either the notifier sees the waiter or the waiter
+// sees the updated ring, and no wakeup is lost. (A fence would do on x86, but TSan can't
+// model fences.)
+// A waiter clears wake_pending (again with an RMW) every time it is about to re-check the
+// ring, and only the notifier that flips it back to true takes the mutex. While the woken
+// thread is still on its way, further operations skip the lock entirely. Because those skipped
+// operations wake nobody, the notifier broadcasts to its side rather than signalling one thread;
+// it never wakes threads blocked on the other side.
+
+static bool lockfree_try_add(channel_t* channel, void* data) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_add(channel->spsc, data) == BUFFER_SUCCESS;
+    }
+    if (channel->kind == CHANNEL_TYPED) {
+        return value_buffer_add(channel->typed, data) == BUFFER_SUCCESS;   // data points to the value
+    }
+    return mpmc_buffer_add(channel->mpmc, data) == BUFFER_SUCCESS;
+}
+
+static bool lockfree_try_remove(channel_t* channel, void** data) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_remove(channel->spsc, data) == BUFFER_SUCCESS;
+    }
+    if (channel->kind == CHANNEL_TYPED) {
+        return value_buffer_remove(channel->typed, *data) == BUFFER_SUCCESS;  // *data points to the caller's storage
+    }
+    return mpmc_buffer_remove(channel->mpmc, data) == BUFFER_SUCCESS;
+}
+
+static bool lockfree_full(channel_t* channel) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_current_size(channel->spsc) >= spsc_buffer_capacity(channel->spsc);
+    }
+    if (channel->kind == CHANNEL_TYPED) {
+        return value_buffer_full(channel->typed);
+    }
+    return mpmc_buffer_full(channel->mpmc);
+}
+
+static bool lockfree_empty(channel_t* channel) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_current_size(channel->spsc) == 0;
+    }
+    if (channel->kind == CHANNEL_TYPED) {
+        return value_buffer_empty(channel->typed);
+    }
+    return mpmc_buffer_empty(channel->mpmc);
+}
+
+#if CHANNEL_STATS
+static channel_counters_t* stats_of(channel_t* channel, enum direction dir) {
+    return (dir == SEND) ? &channel->send_stats : &channel->recv_stats;
+}
+
+static void stats_high_water(channel_t* channel, size_t size) {            // Raise the high-water mark to size
+    size_t seen = atomic_load_explicit(&channel->send_stats.high_water, memory_order_relaxed);
+    while (size > seen && !atomic_compare_exchange_weak_explicit(&channel->send_stats.high_water, &seen, size,
+                                                                 memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static size_t lockfree_size(channel_t* channel) {                           // Messages in a lock-free ring (a snapshot)
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_current_size(channel->spsc);
+    }
+    if (channel->kind == CHANNEL_TYPED) {
+        return value_buffer_current_size(channel->typed);
+    }
+    return mpmc_buffer_current_size(channel->mpmc);
+}
+
+static size_t lockfree_capacity(channel_t* channel) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_capacity(channel->spsc);
+    }
+    if (channel->kind == CHANNEL_TYPED) {
+        return value_buffer_capacity(channel->typed);
+    }
+    return mpmc_buffer_capacity(channel->mpmc);
+}
+#endif
+
+// Counts the outcome of a send or receive of count messages, and passes status through
+// Reading a lock-free ring's size would pull the other side's cache line on every send, so those
+// channels sample it for the high-water mark every CHANNEL_STATS_SAMPLE sends, and whenever they are full
+static enum channel_status stats_count(channel_t* channel, enum direction dir, enum channel_status status, size_t count) {
+#if CHANNEL_STATS
+    channel_counters_t* stats = stats_of(channel, dir);
+    if (status == SUCCESS) {
+        size_t before = atomic_fetch_add_explicit(&stats->ops, count, memory_order_relaxed);
+        if (dir == SEND && is_lockfree(channel) && (before + count) / CHANNEL_STATS_SAMPLE != before / CHANNEL_STATS_SAMPLE) {
+            stats_high_water(channel, lockfree_size(channel));
+        }
+    } else if (status == CHANNEL_FULL) {                                    // Or CHANNEL_EMPTY: a non-blocking call that failed
+        atomic_fetch_add_explicit(&stats->failed, 1, memory_order_relaxed);
+        if (dir == SEND && is_lockfree(channel)) {
+            stats_high_water(channel, lockfree_capacity(channel));
+        }
+    }
+#endif
+    return status;
+}
+
+// Counts a send or receive that had to wait waited nanoseconds for its partner
+static void stats_blocked(channel_t* channel, enum direction dir, unsigned long long waited) {
+#if CHANNEL_STATS
+    channel_counters_t* stats = stats_of(channel, dir);
+    atomic_fetch_add_explicit(&stats->blocked, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->blocked_ns, waited, memory_order_relaxed);
+    if (dir == SEND && is_lockfree(channel)) {
+        stats_high_water(channel, lockfree_capacity(channel));              // It waited for the ring to drain
+    }
+#endif
+}
+
+static void stats_buffered(channel_t* channel) {                           // Raise the high-water mark to what buffer holds now (channel mutex held)
+#if CHANNEL_STATS
+    stats_high_water(channel, buffer_current_size(channel->buffer));
+#endif
+}
+
+// Records how long a finished send or receive waited, if it succeeded or timed out
+static void latency_finish(struct channel_latency* latency, enum direction dir, enum channel_status status, unsigned long long waited) {
+    histogram_t* histogram = atomic_load_explicit((dir == SEND) ? &latency->send : &latency->receive, memory_order_relaxed);
+    if (histogram && (status == SUCCESS || status == TIMEOUT)) {
+        histogram_record(histogram, waited);
+    }
+}
+
+// Notes that count messages sent at since (0 for now) were just added to a CHANNEL_LOCKED buffer (channel mutex held)
+static void latency_sent(channel_t* channel, unsigned long long since, size_t count) {
+    struct channel_latency* latency = latency_of(channel);
+    if (!latency || !latency->sojourn || count == 0) {
+        return;
+    }
+    if (since == 0) {
+        since = clock_ns();
+    }
+    while (count-- > 0 && latency->stamp_count < latency->stamp_capacity) {
+        latency->stamps[(latency->stamp_head + latency->stamp_count++) % latency->stamp_capacity] = since;
+    }
+}
+
+// Records the sojourn times of the count oldest messages, just removed from a CHANNEL_LOCKED buffer (channel mutex held)
+// Messages buffered before the sojourn histogram was attached have no stamp, and are the oldest ones
+static void latency_received(channel_t* channel, size_t count) {
+    struct channel_latency* latency = latency_of(channel);
+    if (!latency || !latency->sojourn || count == 0) {
+        return;
+    }
+    size_t unstamped = buffer_current_size(channel->buffer) + count - latency->stamp_count;
+    unsigned long long now = clock_ns();
+    for (size_t i = 0; i < count; i++) {
+        if (i < unstamped) {
+            continue;
+        }
+        histogram_record(latency->sojourn, now - latency->stamps[latency->stamp_head]);
+        latency->stamp_head = (latency->stamp_head + 1) % latency->stamp_capacity;
+        latency->stamp_count--;
+    }
+}
+
+// Records the sojourn time of a message handed straight from a sender to a receiver; since is when the
+// sender started waiting (from latency_stamp), or 0 if the receiver was the one waiting (channel mutex held)
+static void latency_handed(channel_t* channel, unsigned long long since) {
+    struct channel_latency* latency = latency_of(channel);
+    if (!latency || !latency->sojourn) {
+        return;
+    }
+    histogram_record(latency->sojourn, since ? clock_ns() - since : 0);
+}
+
+// Accounts for a finished send or receive of count messages that waited for waited ns (trace event, latency and counters),
+// and passes status through
+static enum channel_status op_finish(channel_t* channel, enum direction dir, enum channel_status status, size_t count, unsigned long long waited) {
+    TRACE(dir == SEND ? TRACE_SEND : TRACE_RECEIVE, channel, status);
+    struct channel_latency* latency = latency_of(channel);
+    if (latency) {
+        latency_finish(latency, dir, status, waited);
+    }
+    return stats_count(channel, dir, status, count);
+}
+
+// Marks the start of a send or receive waiting for its partner; returns the start time for wait_end,
+// or 0 if neither the blocked_ns counter nor a wait histogram for dir needs it, so nothing reads the clock
+static unsigned long long wait_begin(channel_t* channel, enum direction dir) {
+    TRACE(TRACE_PARK, channel, dir);
+    if (!CHANNEL_STATS && !latency_waits(channel, dir)) {
+        return 0;                                                           // A sojourn-only histogram does not count waits
+    }
+    return clock_ns();
+}
+
+// Marks the end of a wait that started at start; adds its length to *waited, for op_finish
+static void wait_end(channel_t* channel, enum direction dir, unsigned long long start, unsigned long long* waited) {
+    TRACE(TRACE_UNPARK, channel, dir);
+    if (start == 0) {
+        return;
+    }
+    unsigned long long ns = clock_ns() - start;
+    stats_blocked(channel, dir, ns);
+    *waited += ns;
+}
+
+static void lockfree_notify(channel_t* channel, wait_side_t* side) {      // Wake threads parked on side and selects, if any
+    if (atomic_fetch_add(&side->waiters, 0) == 0) {
+        return;                                                             // Common case: nobody to wake, no lock taken
+    }
+    if (atomic_exchange(&side->wake_pending, true)) {
+        return;                                                             // Somebody already woke them since they last looked
+    }
+    TRACE(TRACE_WAKE, channel, SUCCESS);
+    if (channel->park == CHANNEL_PARK_FUTEX || atomic_load(&side->timed_waiters) > 0) {
+        atomic_fetch_add(&side->seq, 1);
+        park_wake_all(&side->seq);                                          // Parked threads hold no lock, wake them directly
+    }
+    pthread_mutex_lock(&channel->mutex);
+    if (channel->park == CHANNEL_PARK_COND) {
+        pthread_cond_broadcast(&side->cond);
+    }
+    stats_notified(channel, signal_subscribers(side));                      // Only the selects waiting for what just happened
+    pthread_mutex_unlock(&channel->mutex);
+}
+
+static bool lockfree_ready(channel_t* channel, void* arg) {
+    bool (**must_wait)(channel_t*) = arg;
+    return channel->end_flag || !(*must_wait)(channel);
+}
+
+// Waits until must_wait is false or the channel is closed; may also return early, at the latest once deadline passed
+// A thread with a deadline parks on seq whatever the channel's park mode: condition variables are never timed
+static void lockfree_park(channel_t* channel, wait_side_t* side, bool (*must_wait)(channel_t*), const struct timespec* deadline) {
+    if (wait_spin(channel, lockfree_ready, &must_wait, deadline)) {
+        return;                                                             // Spinning threads are not counted in waiters, so nobody had to wake us
+    }
+    bool woken = false;
+    bool timed = channel->park == CHANNEL_PARK_COND && deadline != NULL;
+    if (channel->park == CHANNEL_PARK_FUTEX || timed) {
+        atomic_fetch_add(&side->waiters, 1);
+        if (timed) {
+            atomic_fetch_add(&side->timed_waiters, 1);                      // Before the wake_pending exchange, so the notifier that wins it sees us
+        }
+        while (true) {
+            unsigned int seen = atomic_load(&side->seq);                    // Any notify or close from here on changes seq
+            if (channel->end_flag) {
+                break;
+            }
+            atomic_exchange(&side->wake_pending, false);
+            if (!must_wait(channel)) {
+                break;
+            }
+            if (woken) {
+                stats_woken(channel, true);                                 // The wakeup before was for nothing
+                woken = false;
+            }
+            if (!park_wait_until(&side->seq, seen, deadline)) {
+                break;
+            }
+            woken = true;
+        }
+        if (woken) {
+            stats_woken(channel, false);
+        }
+        if (timed) {
+            atomic_fetch_sub(&side->timed_waiters, 1);
+        }
+        atomic_fetch_sub(&side->waiters, 1);
+        return;
+    }
+    pthread_mutex_lock(&channel->mutex);
+    atomic_fetch_add(&side->waiters, 1);
+    while (!channel->end_flag) {
+        atomic_exchange(&side->wake_pending, false);
+        if (!must_wait(channel)) {
+            break;
+        }
+        if (woken) {
+            stats_woken(channel, true);
+            woken = false;
+        }
+        pthread_cond_wait(&side->cond, &channel->mutex);
+        woken = true;
+    }
+    if (woken) {
+        stats_woken(channel, false);
+    }
+    atomic_fetch_sub(&side->waiters, 1);
+    pthread_mutex_unlock(&channel->mutex);
+}
+
+static enum channel_status lockfree_send(channel_t* channel, void* data, bool blocking, const struct timespec* deadline, unsigned long long* waited) {
+    enum channel_status status;
+    bool waiting = false;                                                   // One wait per operation, however many park rounds it takes
+    unsigned long long start = 0;
+    while (true) {
+        if (channel->end_flag) {
+            status = CLOSED_ERROR;
+            break;
+        }
+        if (lockfree_try_add(channel, data)) {
+            status = SUCCESS;
+            break;
+        }
+        if (!blocking) {
+            status = CHANNEL_FULL;
+            break;
+        }
+        if (park_deadline_passed(deadline)) {
+            status = TIMEOUT;
+            break;
+        }
+        if (!waiting) {
+            start = wait_begin(channel, SEND);
+            waiting = true;
+        }
+        lockfree_park(channel, &channel->not_full, lockfree_full, deadline);
+    }
+    if (waiting) {
+        wait_end(channel, SEND, start, waited);
+    }
+    if (status == SUCCESS) {
+        lockfree_notify(channel, &channel->not_empty);
+    }
+    return status;
+}
+
+static enum channel_status lockfree_receive(channel_t* channel, void** data, bool blocking, const struct timespec* deadline, unsigned long long* waited) {
+    enum channel_status status;
+    bool waiting = false;
+    unsigned long long start = 0;
+    while (true) {
+        if (channel->end_flag) {
+            status = CLOSED_ERROR;
+            break;
+        }
+        if (lockfree_try_remove(channel, data)) {
+            status = SUCCESS;
+            break;
+        }
+        if (!blocking) {
+            status = CHANNEL_EMPTY;
+            break;
+        }
+        if (park_deadline_passed(deadline)) {
+            status = TIMEOUT;
+            break;
+        }
+        if (!waiting) {
+            start = wait_begin(channel, RECV);
+            waiting = true;
+        }
+        lockfree_park(channel, &channel->not_empty, lockfree_empty, deadline);
+    }
+    if (waiting) {
+        wait_end(channel, RECV, start, waited);
+    }
+    if (status == SUCCESS) {
+        lockfree_notify(channel, &channel->not_full);
+    }
+    return status;
+}
+
+static size_t lockfree_add_batch(channel_t* channel, void** data, size_t count) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_add_batch(channel->spsc, data, count);
+    }
+    size_t added = 0;                                                       // Vyukov slots have to be claimed one at a time
+    while (added < count && lockfree_try_add(channel, data[added])) {
+        added++;
+    }
+    return added;
+}
+
+static size_t lockfree_remove_batch(channel_t* channel, void** data, size_t count) {
+    if (channel->kind == CHANNEL_SPSC) {
+        return spsc_buffer_remove_batch(channel->spsc, data, count);
+    }
+    size_t removed = 0;
+    while (removed < count && lockfree_try_remove(channel, &data[removed])) {
+        removed++;
+    }
+    return removed;
+}
+
+static enum channel_status lockfree_send_batch(channel_t* channel, void** data, size_t count, size_t* sent, unsigned long long* waited) {
+    enum channel_status status;
+    bool waiting = false;
+    unsigned long long start = 0;
+    while (true) {
+        if (channel->end_flag) {
+            status = CLOSED_ERROR;
+            break;
+        }
+        *sent = lockfree_add_batch(channel, data, count);
+        if (*sent > 0 || count == 0) {
+            status = SUCCESS;
+            break;
+        }
+        if (!waiting) {
+            start = wait_begin(channel, SEND);
+            waiting = true;
+        }
+        lockfree_park(channel, &channel->not_full, lockfree_full, NULL);
+    }
+    if (waiting) {
+        wait_end(channel, SEND, start, waited);
+    }
+    if (status == SUCCESS) {
+        lockfree_notify(channel, &channel->not_empty);                  // One wakeup for the whole batch
+    }
+    return status;
+}
+
+static enum channel_status lockfree_receive_batch(channel_t* channel, void** data, size_t count, size_t* received, unsigned long long* waited) {
+    enum channel_status status;
+    bool waiting = false;
+    unsigned long long start = 0;
+    while (true) {
+        if (channel->end_flag) {
+            status = CLOSED_ERROR;
+            break;
+        }
+        *received = lockfree_remove_batch(channel, data, count);
+        if (*received > 0 || count == 0) {
+            status = SUCCESS;
+            break;
+        }
+        if (!waiting) {
+            start = wait_begin(channel, RECV);
+            waiting = true;
+        }
+        lockfree_park(channel, &channel->not_empty, lockfree_empty, NULL);
+    }
+    if (waiting) {
+        wait_end(channel, RECV, start, waited);
+    }
+    if (status == SUCCESS) {
+        lockfree_notify(channel, &channel->not_full);
+    }
+    return status;
+}
+
+enum channel_status handleError(pthread_mutex_t* mutex, enum channel_status error) {   // Function to handle errors
+    pthread_mutex_unlock(mutex);                                                       // Unlock the mutex
+    return error;
+}
+
+enum channel_status handleSuccess(channel_t* channel) {                                                      // Function to handle success
+    pthread_mutex_unlock(&channel->mutex);                                                                  // Unlock the mutex
+    return SUCCESS;                                                                                         // Return success
+}
+
+// Queues self and blocks until a partner completes it (channel mutex held; released on return)
+// Returns the status the partner left in self, CLOSED_ERROR if the channel closed first,
+// or TIMEOUT if deadline passed first; adds the time it waited to *waited
+static enum channel_status waitq_block(channel_t* channel, waitq_t* queue, waiter_t* self, const struct timespec* deadline,
+                                       unsigned long long* waited) {
+    enum direction dir = (queue == &channel->sendq) ? SEND : RECV;
+    unsigned long long start = wait_begin(channel, dir);
+    waitq_push(queue, self);
+    bool completed = waiter_park(channel, self, deadline);
+    wait_end(channel, dir, start, waited);
+    if (completed) {
+        return self->status;
+    }
+    waitq_unlink(queue, self);                                              // Closed or timed out before anybody took it
+    return handleError(&channel->mutex, channel->end_flag ? CLOSED_ERROR : TIMEOUT);
+}
+
+// Unbuffered channels hold no messages: a sender hands its data straight to a receiver queued on
+// recvq (and vice versa), or queues itself on sendq and waits for one to arrive.
+
+static enum channel_status rendezvous_send(channel_t* channel, void* data, bool blocking, const struct timespec* deadline,
+                                           unsigned long long* waited) {
+    if (pthread_mutex_lock(&channel->mutex) != 0) {
+        return GEN_ERROR;
+    }
+    if (channel->end_flag) {
+        return handleError(&channel->mutex, CLOSED_ERROR);
+    }
+
+    waiter_t* receiver = waitq_pop_claimable(&channel->recvq);
+    if (receiver) {
+        receiver->data = data;                                              // Hand the message over directly
+        waiter_complete(channel, receiver, SUCCESS);
+        latency_handed(channel, 0);
+        pthread_mutex_unlock(&channel->mutex);
+        return SUCCESS;
+    }
+    if (!blocking) {
+        return handleError(&channel->mutex, CHANNEL_FULL);                  // Nobody is ready to take it
+    }
+
+    waiter_t self = {.data = data, .since = latency_stamp(channel)};
+    return waitq_block(channel, &channel->sendq, &self, deadline, waited);
+}
+
+static enum channel_status rendezvous_receive(channel_t* channel, void** data, bool blocking, const struct timespec* deadline,
+                                              unsigned long long* waited) {
+    if (pthread_mutex_lock(&channel->mutex) != 0) {
+        return GEN_ERROR;
+    }
+    if (channel->end_flag) {
+        return handleError(&channel->mutex, CLOSED_ERROR);
+    }
+
+    waiter_t* sender = waitq_pop_claimable(&channel->sendq);
+    if (sender) {
+        *data = sender->data;
+        latency_handed(channel, sender->since);
+        waiter_complete(channel, sender, SUCCESS);
+        pthread_mutex_unlock(&channel->mutex);
+        return SUCCESS;
+    }
+    if (!blocking) {
+        return handleError(&channel->mutex, CHANNEL_EMPTY);
+    }
+
+    waiter_t self = {0};
+    enum channel_status status = waitq_block(channel, &channel->recvq, &self, deadline, waited);
+    if (status == SUCCESS) {
+        *data = self.data;
+    }
+    return status;
+}
+
+// Buffered (CHANNEL_LOCKED, CHANNEL_UNBOUNDED and CHANNEL_PRIORITY) channels hand messages over directly too: a receiver that finds the
+// buffer empty queues itself on recvq, and the next sender writes straight into its waiter record
+// instead of the buffer; a sender that finds the buffer full queues itself with its message on
+// sendq, and the receiver that frees a slot moves that message into the buffer. recvq can only be
+// non-empty while the buffer is empty and sendq only while it is full, so FIFO order is kept,
+// and each message wakes exactly the one thread it completes.
+
+static bool locked_handoff(channel_t* channel, void* data) {               // Give data to a queued receiver, if any (channel mutex held)
+    waiter_t* receiver = waitq_pop_claimable(&channel->recvq);
+    if (!receiver) {
+        return false;
+    }
+    receiver->data = data;
+    waiter_complete(channel, receiver, SUCCESS);
+    latency_handed(channel, 0);
+    return true;
+}
+
+static void locked_refill(channel_t* channel) {                             // Move queued senders' messages into freed slots (channel mutex held)
+    waiter_t* sender;
+    while (buffer_current_size(channel->buffer) < buffer_capacity(channel->buffer) &&
+           (sender = waitq_pop_claimable(&channel->sendq)) != NULL) {
+        buffer_add_priority(channel->buffer, sender->data, sender->priority);
+        latency_sent(channel, sender->since, 1);
+        waiter_complete(channel, sender, SUCCESS);
+    }
+}
+
+// Blocking send with a priority (ignored unless the channel is CHANNEL_PRIORITY) and a deadline (NULL waits forever)
+// Adds the time it waited to *waited
+static enum channel_status send_until(channel_t* channel, void* data, int priority, const struct timespec* deadline, unsigned long long* waited) {
+    if (is_lockfree(channel)) {
+        return lockfree_send(channel, data, true, deadline, waited);
+    }
+    if (channel->kind == CHANNEL_UNBUFFERED) {
+        return rendezvous_send(channel, data, true, deadline, waited);
+    }
+
+    if (pthread_mutex_lock(&channel->mutex) != 0) {     // Lock the mutex before modifying the channel
+        return GEN_ERROR;
+    }
+
+    if (channel->end_flag) {                                                // If channel is closed
+        pthread_mutex_unlock(&channel->mutex);                              // Unlock the mutex after modifying the channel
+        return CLOSED_ERROR;
+    }
+
+    if (locked_handoff(channel, data)) {                                    // A receiver is already waiting for it
+        pthread_mutex_unlock(&channel->mutex);
+        return SUCCESS;
+    }
+
+    if (buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer)) {
+        waiter_t self = {.data = data, .priority = priority, .since = latency_stamp(channel)};
+        return waitq_block(channel, &channel->sendq, &self, deadline, waited);      // The receiver that frees a slot moves data into it
+    }
+
+    enum channel_status sn = buffer_add_priority(channel->buffer, data, priority) == BUFFER_SUCCESS ? SUCCESS : GEN_ERROR;     // Add data to buffer
+    if (sn == SUCCESS) {
+        latency_sent(channel, 0, 1);
+    }
+    stats_buffered(channel);
+
+    pthread_mutex_unlock(&channel->mutex);                                        //  Unlock the mutex after modifying the channel
+
+    return sn;
+}
+
+// Writes data to the given channel
+// This is a blocking call i.e., the function only returns on a successful completion of send
+// In case the channel is full, the function waits till the channel has space to write the new data
+// Returns SUCCESS for successfully writing data to the channel,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+
+enum channel_status channel_send(channel_t *channel, void* data) {      
+    return channel_send_until(channel, data, NULL);
+}
+
+// Same as channel_send, but gives up at deadline, an absolute CLOCK_MONOTONIC time (NULL waits forever)
+// Returns TIMEOUT if the message could not be written before the deadline
+
+enum channel_status channel_send_until(channel_t* channel, void* data, const struct timespec* deadline) {
+    unsigned long long waited = 0;
+    enum channel_status sn = send_until(channel, data, 0, deadline, &waited);
+    return op_finish(channel, SEND, sn, 1, waited);
+}
+
+// Same as channel_send, but a CHANNEL_PRIORITY channel delivers data ahead of every message of a lower priority
+// Other channels ignore priority
+
+enum channel_status channel_send_priority(channel_t* channel, void* data, int priority) {
+    unsigned long long waited = 0;
+    enum channel_status sn = send_until(channel, data, priority, NULL, &waited);
+    return op_finish(channel, SEND, sn, 1, waited);
+}
+
+
+// Reads data from the given channel and stores it in the function's input parameter, data (Note that it is a double pointer)
+// This is a blocking call i.e., the function only returns on a successful completion of receive
+// In case the channel is empty, the function waits till the channel has some data to read
+// Returns SUCCESS for successful retrieval of data,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+
+enum channel_status channel_receive(channel_t* channel, void** data)
+{
+  return channel_receive_until(channel, data, NULL);
+}
+
+// Blocking receive with a deadline (NULL waits forever); adds the time it waited to *waited
+static enum channel_status receive_until(channel_t* channel, void** data, const struct timespec* deadline, unsigned long long* waited)
+{
+  if (is_lockfree(channel)) {
+    return lockfree_receive(channel, data, true, deadline, waited);
+  }
+  if (channel->kind == CHANNEL_UNBUFFERED) {
+    return rendezvous_receive(channel, data, true, deadline, waited);
+  }
+
+  enum channel_status rv = SUCCESS;
+  int lockStatus = pthread_mutex_lock(&channel->mutex);        // lock the channel
+
+  if(lockStatus != 0){                                         // check if the lock was successful
+    return GEN_ERROR;                                          // return error if lock failed 
+  }
+
+  do{
+    if(channel->end_flag){                                     // check if the channel is closed
+      rv = CLOSED_ERROR;                                       // return error, if channel is closed
+      break;                                                   // break from the loop
+    }
+
+    //wait for the next sender to hand us its message if the buffer is empty
+    if(buffer_current_size(channel->buffer) == 0){             // check if the buffer is empty
+      waiter_t self = {0};
+      rv = waitq_block(channel, &channel->recvq, &self, deadline, waited);   // releases the mutex
+      if(rv == SUCCESS){
+        *data = self.data;
+      }
+      return rv;
+    }
+
+    if(buffer_remove(channel->buffer, data) != BUFFER_SUCCESS){ //get data from channel
+      rv = GEN_ERROR;                                           //return error, if remove failed
+      break;
+    }
+    latency_received(channel, 1);
+
+    locked_refill(channel);                                    // let one waiting sender into the freed slot
+
+  }while(0);                                                   // end of do-while loop
+
+  pthread_mutex_unlock(&channel->mutex);                       // unlock the mutex before signalling the subscribers
+
+  return rv;                                                   // return the status
+}
+
+// Same as channel_receive, but gives up at deadline, an absolute CLOCK_MONOTONIC time (NULL waits forever)
+// Returns TIMEOUT if no message could be read before the deadline
+
+enum channel_status channel_receive_until(channel_t* channel, void** data, const struct timespec* deadline)
+{
+  unsigned long long waited = 0;
+  enum channel_status rv = receive_until(channel, data, deadline, &waited);
+  return op_finish(channel, RECV, rv, 1, waited);
+}
+
+// Non-blocking send with a priority (ignored unless the channel is CHANNEL_PRIORITY)
+static enum channel_status non_blocking_send(channel_t* channel, void* data, int priority) {
+    if (is_lockfree(channel)) {
+        return lockfree_send(channel, data, false, NULL, NULL);                // Never waits, so never touches waited
+    }
+    if (channel->kind == CHANNEL_UNBUFFERED) {
+        return rendezvous_send(channel, data, false, NULL, NULL);
+    }
+
+    // Attempt to lock the channel. On failure, return general error
+    if(pthread_mutex_lock(&channel->mutex) != 0){                       // lock the channel
+        return GEN_ERROR;                                               // return error if lock failed
+    }
+
+    // If the channel is closed, unlock the mutex and return closed error
+    if(channel->end_flag){                                              // check if the channel is closed
+        pthread_mutex_unlock(&channel->mutex);                          // unlock the mutex before signalling the subscribers
+        return CLOSED_ERROR;                                            // return error, if channel is closed
+    }
+
+    // If a receiver is waiting, give it the data directly
+    if(locked_handoff(channel, data)){
+        pthread_mutex_unlock(&channel->mutex);
+        return SUCCESS;
+    }
+
+    // If the buffer is full, unlock the mutex and return channel full error
+    if(buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer)){  // check if the buffer is full
+        pthread_mutex_unlock(&channel->mutex);                                     // unlock the mutex before signalling the subscribers
+        return CHANNEL_FULL;                                                       // return error, if channel is full
+    }
+
+    // Try to add data to buffer, on failure unlock mutex and return general error
+    if(buffer_add_priority(channel->buffer, data, priority) != BUFFER_SUCCESS){    // add data to channel
+        pthread_mutex_unlock(&channel->mutex);                                     // unlock the mutex before signalling the subscribers
+        return GEN_ERROR;                                                          // return error, if add failed
+    }
+    latency_sent(channel, 0, 1);
+    stats_buffered(channel);
+
+    // Finally unlock the mutex and return success
+    pthread_mutex_unlock(&channel->mutex);                              // unlock the mutex before signalling the subscribers
+
+    return SUCCESS;
+}
+
+// Writes data to the given channel
+// This is a non-blocking call i.e., the function simply returns if the channel is full
+// Returns SUCCESS for successfully writing data to the channel,
+// CHANNEL_FULL if the channel is full and the data was not added to the buffer,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+
+enum channel_status channel_non_blocking_send(channel_t* channel, void* data) {
+    return op_finish(channel, SEND, non_blocking_send(channel, data, 0), 1, 0);
+}
+
+// Same as channel_non_blocking_send, but a CHANNEL_PRIORITY channel delivers data ahead of every message of a lower priority
+// Other channels ignore priority
+
+enum channel_status channel_non_blocking_send_priority(channel_t* channel, void* data, int priority) {
+    return op_finish(channel, SEND, non_blocking_send(channel, data, priority), 1, 0);
+}
+
+// Non-blocking receive, without counting it
+static enum channel_status non_blocking_receive(channel_t* channel, void** data)
+{
+    if (is_lockfree(channel)) {
+        return lockfree_receive(channel, data, false, NULL, NULL);
+    }
+    if (channel->kind == CHANNEL_UNBUFFERED) {
+        return rendezvous_receive(channel, data, false, NULL, NULL);
+    }
+
+    if (pthread_mutex_lock(&channel->mutex) != 0){                                                          // Lock the mutex
+        return GEN_ERROR;
+    }
+
+    if(channel->end_flag){
         return handleError(&channel->mutex, CLOSED_ERROR);                                                            // Return error if channel is closed
     } else if(buffer_current_size(channel->buffer) == 0){
         return handleError(&channel->mutex, CHANNEL_EMPTY);                                                    //  Return error if channel is empty
@@ -291,9 +1555,246 @@ enum channel_status channel_non_blocking_receive(channel_t* channel, void** data
         if (buffer_status != BUFFER_SUCCESS) {
             return handleError(&channel->mutex, GEN_ERROR);                                                // Return error if data was not removed successfully
         } else {                                                                                           // If data was removed successfully 
-            return handleSuccess(&channel->mutex, &channel->cond, channel->subscribers);                   // Handle success
+            latency_received(channel, 1);
+            locked_refill(channel);                                                                        // Let one waiting sender into the freed slot
+            return handleSuccess(channel);                                                                 // Handle success
+        }
+    }
+}
+
+// Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
+// This is a non-blocking call i.e., the function simply returns if the channel is empty
+// Returns SUCCESS for successful retrieval of data,
+// CHANNEL_EMPTY if the channel is empty and nothing was stored in data,
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+
+enum channel_status channel_non_blocking_receive(channel_t* channel, void** data)
+{
+    return op_finish(channel, RECV, non_blocking_receive(channel, data), 1, 0);
+}
+
+// Blocking send of up to count messages, without counting them
+static enum channel_status send_batch(channel_t* channel, void** data, size_t count, size_t* sent, unsigned long long* waited)
+{
+    *sent = 0;
+    if (is_lockfree(channel)) {
+        return lockfree_send_batch(channel, data, count, sent, waited);
+    }
+    if (channel->kind == CHANNEL_UNBUFFERED) {                                               // Every message needs its own receiver
+        if (count == 0) return channel->end_flag ? CLOSED_ERROR : SUCCESS;
+        enum channel_status sn = rendezvous_send(channel, data[0], true, NULL, waited);
+        *sent = (sn == SUCCESS);
+        return sn;
+    }
+
+    if (pthread_mutex_lock(&channel->mutex) != 0) {                                          // Lock the mutex once for the whole batch
+        return GEN_ERROR;
+    }
+
+    if (channel->end_flag) {
+        return handleError(&channel->mutex, CLOSED_ERROR);                                   // Return error if channel is closed
+    }
+
+    while (*sent < count && locked_handoff(channel, data[*sent])) {                          // Serve the receivers already waiting first
+        (*sent)++;
+    }
+    size_t handed = *sent;
+    *sent += buffer_add_batch(channel->buffer, data + *sent, count - *sent);                 // Copy as much of the rest as fits
+    latency_sent(channel, 0, *sent - handed);
+    stats_buffered(channel);
+
+    if (*sent == 0 && count > 0) {
+        waiter_t self = {.data = data[0], .since = latency_stamp(channel)};
+        enum channel_status sn = waitq_block(channel, &channel->sendq, &self, NULL, waited);        // Wait for a receiver to take the first one
+        *sent = (sn == SUCCESS);
+        return sn;
+    }
+    return handleSuccess(channel);
+}
+
+// Writes up to count messages from data to the given channel, in order, under a single lock acquisition
+// This is a blocking call i.e., the function waits till the channel has space for at least one message
+// Stores the number of messages written in sent (at most count; fewer if the channel filled up)
+// Returns SUCCESS for successfully writing at least one message (or count == 0),
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+
+enum channel_status channel_send_batch(channel_t* channel, void** data, size_t count, size_t* sent)
+{
+    unsigned long long waited = 0;
+    enum channel_status sn = send_batch(channel, data, count, sent, &waited);
+    return op_finish(channel, SEND, sn, *sent, waited);
+}
+
+// Blocking receive of up to count messages, without counting them
+static enum channel_status receive_batch(channel_t* channel, void** data, size_t count, size_t* received, unsigned long long* waited)
+{
+    *received = 0;
+    if (is_lockfree(channel)) {
+        return lockfree_receive_batch(channel, data, count, received, waited);
+    }
+    if (channel->kind == CHANNEL_UNBUFFERED) {
+        if (count == 0) return channel->end_flag ? CLOSED_ERROR : SUCCESS;
+        enum channel_status sn = rendezvous_receive(channel, data, true, NULL, waited);
+        *received = (sn == SUCCESS);
+        return sn;
+    }
+
+    if (pthread_mutex_lock(&channel->mutex) != 0) {                                          // Lock the mutex once for the whole batch
+        return GEN_ERROR;
+    }
+
+    if (channel->end_flag) {
+        return handleError(&channel->mutex, CLOSED_ERROR);                                   // Return error if channel is closed
+    }
+
+    if (count > 0 && buffer_current_size(channel->buffer) == 0) {
+        waiter_t self = {0};
+        enum channel_status sn = waitq_block(channel, &channel->recvq, &self, NULL, waited);        // Wait for a sender to hand us one
+        if (sn == SUCCESS) {
+            data[0] = self.data;
+            *received = 1;
+        }
+        return sn;
+    }
+
+    while (*received < count && buffer_current_size(channel->buffer) > 0) {
+        size_t removed = buffer_remove_batch(channel->buffer, data + *received, count - *received);   // Drain as much as is available
+        latency_received(channel, removed);
+        *received += removed;
+        locked_refill(channel);                                                              // Queued senders fill the freed slots
+    }
+    return handleSuccess(channel);
+}
+
+// Reads up to count messages from the given channel into data, in FIFO order, under a single lock acquisition
+// This is a blocking call i.e., the function waits till the channel has at least one message to read
+// Stores the number of messages read in received (at most count; fewer if the channel ran empty)
+// Returns SUCCESS for successfully reading at least one message (or count == 0),
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+
+enum channel_status channel_receive_batch(channel_t* channel, void** data, size_t count, size_t* received)
+{
+    unsigned long long waited = 0;
+    enum channel_status sn = receive_batch(channel, data, count, received, &waited);
+    return op_finish(channel, RECV, sn, *received, waited);
+}
+
+// Copies the elem_size bytes value points to into a CHANNEL_TYPED channel; blocks like channel_send
+enum channel_status channel_send_value(channel_t* channel, const void* value)
+{
+    if (channel->kind != CHANNEL_TYPED) {
+        return GEN_ERROR;
+    }
+    unsigned long long waited = 0;
+    enum channel_status sn = lockfree_send(channel, (void*) value, true, NULL, &waited);        // Only read through, by value_buffer_add
+    return op_finish(channel, SEND, sn, 1, waited);
+}
+
+// Copies the oldest value of a CHANNEL_TYPED channel into value (elem_size bytes); blocks like channel_receive
+enum channel_status channel_receive_value(channel_t* channel, void* value)
+{
+    if (channel->kind != CHANNEL_TYPED) {
+        return GEN_ERROR;
+    }
+    unsigned long long waited = 0;
+    enum channel_status sn = lockfree_receive(channel, &value, true, NULL, &waited);
+    return op_finish(channel, RECV, sn, 1, waited);
+}
+
+// Same as channel_send_value, but returns CHANNEL_FULL instead of blocking
+enum channel_status channel_non_blocking_send_value(channel_t* channel, const void* value)
+{
+    if (channel->kind != CHANNEL_TYPED) {
+        return GEN_ERROR;
+    }
+    return op_finish(channel, SEND, lockfree_send(channel, (void*) value, false, NULL, NULL), 1, 0);
+}
+
+// Same as channel_receive_value, but returns CHANNEL_EMPTY instead of blocking
+enum channel_status channel_non_blocking_receive_value(channel_t* channel, void* value)
+{
+    if (channel->kind != CHANNEL_TYPED) {
+        return GEN_ERROR;
+    }
+    return op_finish(channel, RECV, lockfree_receive(channel, &value, false, NULL, NULL), 1, 0);
+}
+
+// Stores a snapshot of the channel's counters in stats
+// Returns SUCCESS, or GEN_ERROR if the counters were compiled out
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats)
+{
+#if CHANNEL_STATS
+    *stats = (channel_stats_t) {
+        .sends = atomic_load_explicit(&channel->send_stats.ops, memory_order_relaxed),
+        .receives = atomic_load_explicit(&channel->recv_stats.ops, memory_order_relaxed),
+        .send_full = atomic_load_explicit(&channel->send_stats.failed, memory_order_relaxed),
+        .receive_empty = atomic_load_explicit(&channel->recv_stats.failed, memory_order_relaxed),
+        .blocked_sends = atomic_load_explicit(&channel->send_stats.blocked, memory_order_relaxed),
+        .blocked_receives = atomic_load_explicit(&channel->recv_stats.blocked, memory_order_relaxed),
+        .blocked_ns = atomic_load_explicit(&channel->send_stats.blocked_ns, memory_order_relaxed) +
+                      atomic_load_explicit(&channel->recv_stats.blocked_ns, memory_order_relaxed),
+        .wakeups = atomic_load_explicit(&channel->wake_stats.wakeups, memory_order_relaxed),
+        .futile_wakeups = atomic_load_explicit(&channel->wake_stats.futile_wakeups, memory_order_relaxed),
+        .select_notifications = atomic_load_explicit(&channel->wake_stats.select_notifications, memory_order_relaxed),
+        .high_water = atomic_load_explicit(&channel->send_stats.high_water, memory_order_relaxed),
+    };
+    return SUCCESS;
+#else
+    (void) channel;
+    memset(stats, 0, sizeof(*stats));
+    return GEN_ERROR;
+#endif
+}
+
+// Allocates the latency state of a channel, with room for a stamp per slot of a CHANNEL_LOCKED buffer
+// Returns NULL if memory ran out
+static struct channel_latency* latency_create(channel_t* channel)
+{
+    struct channel_latency* latency = calloc(1, sizeof(struct channel_latency));
+    if (!latency) {
+        return NULL;
+    }
+    if (channel->kind == CHANNEL_LOCKED) {
+        latency->stamp_capacity = buffer_capacity(channel->buffer);
+        latency->stamps = malloc(latency->stamp_capacity * sizeof(unsigned long long));
+        if (!latency->stamps) {
+            free(latency);
+            return NULL;
+        }
+    }
+    return latency;
+}
+
+// Starts recording into the histograms of latency (NULL detaches them all)
+// Returns SUCCESS, or GEN_ERROR if memory ran out
+enum channel_status channel_attach_latency(channel_t* channel, const channel_latency_t* latency)
+{
+    if (pthread_mutex_lock(&channel->mutex) != 0) {
+        return GEN_ERROR;
+    }
+    struct channel_latency* state = atomic_load_explicit(&channel->latency, memory_order_relaxed);
+    if (!state && latency) {
+        if (!(state = latency_create(channel))) {
+            return handleError(&channel->mutex, GEN_ERROR);
+        }
+        atomic_store_explicit(&channel->latency, state, memory_order_release);
+    }
+    if (state) {
+        channel_latency_t none = {0};
+        if (!latency) {
+            latency = &none;
         }
+        atomic_store_explicit(&state->send, latency->send, memory_order_relaxed);
+        atomic_store_explicit(&state->receive, latency->receive, memory_order_relaxed);
+        atomic_store_explicit(&state->select, latency->select, memory_order_relaxed);
+        bool in_order = channel->kind == CHANNEL_LOCKED || channel->kind == CHANNEL_UNBUFFERED;
+        state->sojourn = in_order ? latency->sojourn : NULL;
+        state->stamp_count = 0;                                                                     // Messages buffered by now go unstamped
     }
+    return handleSuccess(channel);
 }
 
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
@@ -314,10 +1815,15 @@ enum channel_status channel_close(channel_t* channel)
     }
 
     channel->end_flag = 1;                                                                          // Set the end flag to 1
+    TRACE(TRACE_CLOSE, channel, SUCCESS);
 
-    list_foreach(channel->subscribers, SignalSubscriber);                                           // Signal the subscribers
+    stats_notified(channel, signal_subscribers(&channel->not_full));                                // Signal the subscribers on both sides
+    stats_notified(channel, signal_subscribers(&channel->not_empty));
 
-    pthread_cond_broadcast(&channel->cond);                                                         // Broadcast the condition variable
+    side_wake_all(channel, &channel->not_full);                                                     // Wake every blocked sender and receiver
+    side_wake_all(channel, &channel->not_empty);
+    waitq_wake_all(channel, &channel->sendq);
+    waitq_wake_all(channel, &channel->recvq);
 
     pthread_mutex_unlock(&channel->mutex);                                                          // Unlock the mutex
 
@@ -341,21 +1847,361 @@ enum channel_status channel_destroy(channel_t* channel)
     if (channel_not_closed) {                                                               // Return error if channel is not closed
         return DESTROY_ERROR;                                                               // Return error if channel is not closed
     }
+    if (channel->in_array) {                                                                // Lives in an arena; see channel_destroy_array
+        return GEN_ERROR;
+    }
 
-    // cleanup synchronization primitives
-    pthread_cond_destroy(&channel->cond);                                                   // Destroy the condition variable
-    pthread_mutex_destroy(&channel->mutex);                                                 // Destroy the mutex
+    // cleanup synchronization primitives and free resources associated with the channel
+    channel_fini(channel);
+    channel_free_backend(channel);
 
-    // free resources associated with the channel
-    buffer_free(channel->buffer);                                                           //  Free the buffer
-    list_destroy(channel->subscribers);                                                     // Destroy the list of subscribers
-    
     // deallocate the channel
     free(channel);                                                                          // Free the channel
 
     return SUCCESS;
 }
 
+// Creates count channels of the given size (0 for unbuffered channels), laid out in one arena together
+// with their rings and the returned table of pointers to them
+// Returns NULL if count is 0 or the arena could not be allocated
+channel_t** channel_create_array(size_t count, size_t size)
+{
+    if (count == 0) {
+        return NULL;
+    }
+    channel_attr_t attr = {size == 0 ? CHANNEL_UNBUFFERED : CHANNEL_LOCKED, size, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK};
+    size_t table = (count * sizeof(channel_t*) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    size_t ring = size ? (buffer_pow2_slots(size) * sizeof(void*) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE : 0;
+    size_t node = sizeof(channel_t) + (size ? sizeof(buffer_t) + ring : 0);   // Each channel right before its buffer and ring
+    if (count > (SIZE_MAX - table) / node) {
+        return NULL;
+    }
+    unsigned char* arena = aligned_alloc(CACHE_LINE_SIZE, table + count * node);
+    if (!arena) {
+        perror("malloc");
+        return NULL;
+    }
+
+    channel_t** channels = (channel_t**) arena;
+    for (size_t i = 0; i < count; i++) {
+        unsigned char* block = arena + table + i * node;
+        channel_t* channel = (channel_t*) block;
+        channel->buffer = NULL;
+        channel->spsc = NULL;
+        channel->mpmc = NULL;
+        channel->typed = NULL;
+        if (size) {
+            channel->buffer = (buffer_t*) (block + sizeof(channel_t));
+            buffer_init_pow2(channel->buffer, (void**) (block + sizeof(channel_t) + sizeof(buffer_t)), size);
+        }
+        if (!channel_init(channel, &attr, true)) {
+            while (i > 0) {
+                channel_fini(channels[--i]);
+            }
+            free(arena);
+            return NULL;
+        }
+        channels[i] = channel;
+    }
+    return channels;
+}
+
+// Frees count channels made by channel_create_array, and the table itself
+// Returns SUCCESS, or DESTROY_ERROR (and frees nothing) if any of them is still open
+enum channel_status channel_destroy_array(channel_t** channels, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (atomic_load(&channels[i]->end_flag) == 0) {
+            return DESTROY_ERROR;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        channel_fini(channels[i]);
+    }
+    free(channels);                                                                         // The table starts the arena
+    return SUCCESS;
+}
+
+// Returns a nonzero xorshift seed for SELECT_RANDOM, mixed from the address of its owner and the time
+static uint32_t select_seed(const void* owner)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint32_t x = (uint32_t)((uintptr_t)owner >> 4) ^ (uint32_t)now.tv_nsec;
+    return x ? x : 1;
+}
+
+static size_t select_random(uint32_t* seed, size_t channel_count)     // Returns a random case index below channel_count
+{
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return (size_t)(((uint64_t)x * channel_count) >> 32);
+}
+
+// Returns the case a select with the given order scans first; next is where round robin left off
+static size_t select_start(enum select_order order, size_t next, uint32_t* seed, size_t channel_count)
+{
+    switch (order) {
+    case SELECT_RANDOM:
+        return select_random(seed, channel_count);
+    case SELECT_ROUND_ROBIN:
+        return next % channel_count;                        // Cases may have been removed since
+    default:
+        return 0;
+    }
+}
+
+static int compare_channels(const void* a, const void* b)
+{
+    uintptr_t x = (uintptr_t)*(channel_t* const*)a, y = (uintptr_t)*(channel_t* const*)b;
+    return (x > y) - (x < y);
+}
+
+// Stores the distinct locked and unbuffered channels of channel_list in locks (room for channel_count),
+// in address order: every select takes their mutexes in that order, so two selects never deadlock
+// Lock-free channels are left out; a select never holds their mutex
+// Returns how many channels were stored
+static size_t select_lock_order(select_t* channel_list, size_t channel_count, channel_t** locks)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < channel_count; i++) {
+        if (!is_lockfree(channel_list[i].channel)) {
+            locks[count++] = channel_list[i].channel;
+        }
+    }
+    qsort(locks, count, sizeof(channel_t*), compare_channels);
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; i++) {                    // A channel used by several cases is locked once
+        if (distinct == 0 || locks[distinct - 1] != locks[i]) {
+            locks[distinct++] = locks[i];
+        }
+    }
+    return distinct;
+}
+
+static void select_lock_all(channel_t** locks, size_t lock_count)
+{
+    for (size_t i = 0; i < lock_count; i++) {
+        pthread_mutex_lock(&locks[i]->mutex);
+    }
+}
+
+static void select_unlock_all(channel_t** locks, size_t lock_count)
+{
+    for (size_t i = lock_count; i > 0; i--) {
+        pthread_mutex_unlock(&locks[i - 1]->mutex);
+    }
+}
+
+// Tries one case without blocking, with its channel mutex held unless the channel is lock-free
+// Returns SUCCESS, CLOSED_ERROR if the channel is closed, CHANNEL_FULL or CHANNEL_EMPTY if the case
+// has to wait, and GEN_ERROR on any other generic error
+static enum channel_status select_try(select_t* sel)
+{
+    channel_t* channel = sel->channel;
+    if (is_lockfree(channel)) {
+        return (sel->dir == SEND) ? lockfree_send(channel, sel->data, false, NULL, NULL) : lockfree_receive(channel, &sel->data, false, NULL, NULL);
+    }
+    if (channel->end_flag) {
+        return CLOSED_ERROR;
+    }
+
+    if (sel->dir == SEND) {
+        if (locked_handoff(channel, sel->data)) {                                  // A receiver (or a receiving select) is queued
+            return SUCCESS;
+        }
+        if (channel->kind == CHANNEL_UNBUFFERED || buffer_current_size(channel->buffer) == buffer_capacity(channel->buffer)) {
+            return CHANNEL_FULL;
+        }
+        if (buffer_add_priority(channel->buffer, sel->data, sel->priority) != BUFFER_SUCCESS) {
+            return GEN_ERROR;
+        }
+        latency_sent(channel, 0, 1);
+        stats_buffered(channel);
+        return SUCCESS;
+    }
+
+    if (channel->kind == CHANNEL_UNBUFFERED) {
+        waiter_t* sender = waitq_pop_claimable(&channel->sendq);
+        if (!sender) {
+            return CHANNEL_EMPTY;
+        }
+        sel->data = sender->data;
+        latency_handed(channel, sender->since);
+        waiter_complete(channel, sender, SUCCESS);
+        return SUCCESS;
+    }
+    if (buffer_current_size(channel->buffer) == 0) {
+        return CHANNEL_EMPTY;
+    }
+    if (buffer_remove(channel->buffer, &sel->data) != BUFFER_SUCCESS) {
+        return GEN_ERROR;
+    }
+    latency_received(channel, 1);
+    locked_refill(channel);                                                         // Let a queued sender into the freed slot
+    return SUCCESS;
+}
+
+// Makes one pass over the cases with every channel mutex held, starting with case start and wrapping around
+// Returns the index of the first case that completed or failed, or channel_count if they all have to wait
+static size_t select_scan(select_t* channel_list, size_t channel_count, size_t start, enum channel_status* sn)
+{
+    for (size_t k = 0; k < channel_count; k++) {            // Iterate over the channel list
+        size_t i = (start + k < channel_count) ? start + k : start + k - channel_count;
+        enum channel_status result = select_try(&channel_list[i]);
+        if (result != CHANNEL_FULL && result != CHANNEL_EMPTY) {
+            *sn = result;                                   // Set the status
+            return i;
+        }
+    }
+    return channel_count;
+}
+
+// Tries every case once, locking one channel at a time: the fast path for a select that has a case ready
+// Returns the index of the first case that completed or failed, or channel_count
+static size_t select_poll(select_t* channel_list, size_t channel_count, size_t start, enum channel_status* sn)
+{
+    for (size_t k = 0; k < channel_count; k++) {
+        size_t i = (start + k < channel_count) ? start + k : start + k - channel_count;
+        channel_t* channel = channel_list[i].channel;
+        if (!is_lockfree(channel)) {
+            pthread_mutex_lock(&channel->mutex);
+        }
+        enum channel_status result = select_try(&channel_list[i]);
+        if (!is_lockfree(channel)) {
+            pthread_mutex_unlock(&channel->mutex);
+        }
+        if (result != CHANNEL_FULL && result != CHANNEL_EMPTY) {
+            *sn = result;
+            return i;
+        }
+    }
+    return channel_count;
+}
+
+// Blocks until one case completes, with subscriberPtr set up for channel_list and locks from select_lock_order
+// With every channel mutex held, this either completes a ready case, or queues a waiter for every case
+// at once and sleeps until the partner that takes one of them completes exactly that case. Only lock-free
+// channels, which can't complete a case for us, wake the select to make another pass.
+// Leaves no waiter queued, so the subscriber can be destroyed or waited on again afterwards
+static enum channel_status select_block(select_t* channel_list, size_t channel_count, size_t start, channel_t** locks, size_t lock_count,
+                                        Subscriber* subscriberPtr, size_t* selected_index, const struct timespec* deadline)
+{
+    enum channel_status sn = SUCCESS;
+
+    while (true) {
+        subscriber_rearm(channel_list, channel_count, subscriberPtr);
+        select_lock_all(locks, lock_count);
+        *selected_index = select_scan(channel_list, channel_count, start, &sn);
+        if (*selected_index < channel_count) {
+            select_unlock_all(locks, lock_count);
+            return sn;
+        }
+        subscriber_enqueue(channel_list, channel_count, subscriberPtr);             // Partners may complete a case from here on
+        select_unlock_all(locks, lock_count);
+
+        TRACE(TRACE_PARK, NULL, channel_count);
+        bool signalled = subscriber_wait(subscriberPtr, deadline);
+        TRACE(TRACE_UNPARK, NULL, channel_count);
+        bool fired = !subscriber_withdraw(subscriberPtr);
+        select_lock_all(locks, lock_count);
+        subscriber_retract(channel_list, channel_count, subscriberPtr);
+        select_unlock_all(locks, lock_count);
+        if (fired) {
+            waiter_t* waiter = &subscriberPtr->waiters[subscriberPtr->fired];
+            *selected_index = subscriberPtr->fired;
+            if (waiter->status == SUCCESS && channel_list[*selected_index].dir == RECV) {
+                channel_list[*selected_index].data = waiter->data;                   // Message handed to us by the sender
+            }
+            return waiter->status;
+        }
+        if (!signalled) {                                                           // Deadline passed, and our waiters are gone
+            *selected_index = channel_count;
+            return TIMEOUT;
+        }
+    }
+}
+
+#define SELECT_INLINE_CASES 8                               // Selects with up to this many cases allocate nothing
+
+// Returns the time a select starts waiting from, if any of its channels has latency histograms attached, and 0 otherwise
+static unsigned long long select_clock(select_t* channel_list, size_t channel_count)
+{
+    for (size_t i = 0; i < channel_count; i++) {
+        if (latency_of(channel_list[i].channel)) {
+            return clock_ns();
+        }
+    }
+    return 0;
+}
+
+// Accounts for the operation of the case a select took on its channel (trace event, latency and counters),
+// after waiting since start (from select_clock; 0 if it did not wait), and passes sn through
+static enum channel_status select_count(select_t* sel, enum channel_status sn, unsigned long long start)
+{
+    TRACE(TRACE_SELECT, sel->channel, sn);
+    if (sn != SUCCESS) {
+        return sn;
+    }
+    struct channel_latency* latency = latency_of(sel->channel);
+    histogram_t* histogram = latency ? atomic_load_explicit(&latency->select, memory_order_relaxed) : NULL;
+    if (histogram) {
+        histogram_record(histogram, start ? clock_ns() - start : 0);
+    }
+    return stats_count(sel->channel, sel->dir, sn, 1);
+}
+
+// Runs a one-off select over channel_list until a case completes, or deadline passes (NULL waits forever)
+static enum channel_status select_run(select_t* channel_list, size_t channel_count, size_t* selected_index,
+                                      enum select_order order, const struct timespec* deadline)
+{
+    if (order > SELECT_RANDOM) {
+        return GEN_ERROR;                                                           // No state to round robin on across calls
+    }
+    size_t start = 0;
+    if (order == SELECT_RANDOM) {
+        uint32_t seed = select_seed(channel_list);                                  // One call draws once, so a fresh seed will do
+        start = select_random(&seed, channel_count);
+    }
+    enum channel_status sn = SUCCESS;
+
+    *selected_index = select_poll(channel_list, channel_count, start, &sn);
+    if (*selected_index < channel_count) {
+        return select_count(&channel_list[*selected_index], sn, 0);
+    }
+    unsigned long long since = select_clock(channel_list, channel_count);
+
+    Subscriber subscriber;                                                          // Lives on our stack: partners only reach it under a channel lock
+    waiter_t inline_waiters[SELECT_INLINE_CASES];
+    channel_t* inline_locks[SELECT_INLINE_CASES];
+    waiter_t* waiters = inline_waiters;
+    channel_t** locks = inline_locks;
+    size_t scratch = channel_count * (sizeof(waiter_t) + sizeof(channel_t*));     // One block for both arrays
+    if (channel_count > SELECT_INLINE_CASES) {
+        waiters = pool_alloc(scratch);                                              // Reused by the thread's next large select
+        if (!waiters) {
+            return GEN_ERROR;
+        }
+        locks = (channel_t**)(waiters + channel_count);
+    }
+    if (!subscriber_init(&subscriber, waiters, channel_list, channel_count)) {
+        if (waiters != inline_waiters) pool_free(waiters, scratch);
+        return GEN_ERROR;
+    }
+    size_t lock_count = select_lock_order(channel_list, channel_count, locks);
+    sn = select_block(channel_list, channel_count, start, locks, lock_count, &subscriber, selected_index, deadline);
+    subscriber_destroy(channel_list, channel_count, &subscriber);                   // Unsubscribe from the lock-free channels
+    if (waiters != inline_waiters) pool_free(waiters, scratch);
+    if (sn == TIMEOUT) {
+        TRACE(TRACE_SELECT, NULL, sn);
+        return sn;
+    }
+    return select_count(&channel_list[*selected_index], sn, since);
+}
+
 // Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
 // This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
 // If multiple options are available, it selects the first option and performs its corresponding action
@@ -365,44 +2211,428 @@ enum channel_status channel_destroy(channel_t* channel)
 // Additionally, selected_index is set to the index of the channel that generated the error
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index)
 {
-    size_t i;
-    Subscriber* subscriberPtr = NULL;   // Pointer to subscriber object
-    enum channel_status sn = SUCCESS;   // Assume success 
-
-    *selected_index = channel_count;    // Set selected index to an invalid value initially
-
-    do {
-        for (i = 0; i < channel_count; i++) {               // Iterate over the channel list
-            select_t* sel = &channel_list[i];                                 
-            enum channel_status result;                     // Variable to store the result of the operation
-            if (sel->dir == SEND) {
-                result = channel_non_blocking_send(sel->channel, sel->data);            // Perform the operation
-            } else {
-                result = channel_non_blocking_receive(sel->channel, &sel->data);                // Perform the operation
-            }   
-
-            if (result == SUCCESS || result == CLOSED_ERROR) {                          //  If the operation was successful or the channel is closed
-                *selected_index = i;                // Set the selected index   
-                sn = result;            // Set the status   
-                break;                                              
-            }
+    return channel_select_ordered(channel_list, channel_count, selected_index, SELECT_IN_ORDER);
+}
+
+// Same as channel_select, except that if multiple options are available, order decides which one is taken
+// Returns GEN_ERROR if order is invalid or SELECT_ROUND_ROBIN (select sets only), otherwise the same as channel_select
+enum channel_status channel_select_ordered(select_t* channel_list, size_t channel_count, size_t* selected_index, enum select_order order)
+{
+    return select_run(channel_list, channel_count, selected_index, order, NULL);
+}
+
+// Same as channel_select, but gives up at deadline, an absolute CLOCK_MONOTONIC time (NULL waits forever)
+// Returns TIMEOUT, with selected_index set to channel_count, if no case could complete before the deadline
+enum channel_status channel_select_until(select_t* channel_list, size_t channel_count, size_t* selected_index, const struct timespec* deadline)
+{
+    return select_run(channel_list, channel_count, selected_index, SELECT_IN_ORDER, deadline);
+}
+
+// Creates an empty select set
+// Returns NULL if the set could not be allocated
+select_set_t* select_set_create(void)
+{
+    select_set_t* set = (select_set_t*) calloc(1, sizeof(select_set_t));
+    if (!set) {
+        return NULL;
+    }
+    set->seed = select_seed(set);
+    if (!subscriber_init(&set->subscriber, NULL, NULL, 0)) {                        // Cases subscribe one by one in select_set_add
+        free(set);
+        return NULL;
+    }
+    return set;
+}
+
+// Adds a case to the set and registers the set with its channel
+// Returns SUCCESS, or GEN_ERROR if entry is already in the set or memory ran out
+enum channel_status select_set_add(select_set_t* set, select_t* entry)
+{
+    for (size_t i = 0; i < set->count; i++) {
+        if (set->entries[i] == entry) {
+            return GEN_ERROR;
+        }
+    }
+    if (set->count == set->capacity) {                                              // No offer is queued between waits, so the arrays may move
+        size_t capacity = set->capacity ? 2 * set->capacity : 4;
+        select_t** entries = realloc(set->entries, capacity * sizeof(select_t*));
+        if (!entries) {
+            return GEN_ERROR;
+        }
+        set->entries = entries;
+        select_t* cases = realloc(set->cases, capacity * sizeof(select_t));
+        if (!cases) {
+            return GEN_ERROR;
+        }
+        set->cases = cases;
+        channel_t** locks = realloc(set->locks, capacity * sizeof(channel_t*));
+        if (!locks) {
+            return GEN_ERROR;
+        }
+        set->locks = locks;
+        waiter_t* waiters = malloc(capacity * sizeof(waiter_t));                    // Not realloc: subscribed nodes are linked from their channels
+        if (!waiters) {
+            return GEN_ERROR;
+        }
+        for (size_t k = 0; k < set->count; k++) {
+            subscriber_move(&set->cases[k], &set->subscriber.waiters[k], &waiters[k]);
+        }
+        free(set->subscriber.waiters);
+        set->subscriber.waiters = waiters;
+        set->capacity = capacity;
+    }
+
+    size_t i = set->count++;
+    set->entries[i] = entry;
+    set->cases[i] = *entry;
+    set->subscriber.waiters[i] = (waiter_t) {.select = &set->subscriber, .index = i};
+    subscriber_register(&set->cases[i], &set->subscriber.waiters[i]);
+    set->lock_count = select_lock_order(set->cases, set->count, set->locks);
+    return SUCCESS;
+}
+
+// Removes a case from the set
+// Returns SUCCESS, or GEN_ERROR if entry is not in the set
+enum channel_status select_set_remove(select_set_t* set, select_t* entry)
+{
+    size_t i = 0;
+    while (i < set->count && set->entries[i] != entry) {
+        i++;
+    }
+    if (i == set->count) {
+        return GEN_ERROR;
+    }
+
+    waiter_t* waiters = set->subscriber.waiters;
+    subscriber_unregister(&set->cases[i], &waiters[i]);
+
+    set->count--;
+    if (set->next > i) {                                                            // Round robin carries on with the same case
+        set->next--;
+    }
+    for (size_t k = i; k < set->count; k++) {                                       // Keep the order cases were added in
+        set->entries[k] = set->entries[k + 1];
+        set->cases[k] = set->cases[k + 1];
+        subscriber_move(&set->cases[k], &waiters[k + 1], &waiters[k]);
+        waiters[k].index = k;
+    }
+    set->lock_count = select_lock_order(set->cases, set->count, set->locks);
+    return SUCCESS;
+}
+
+// Sets which ready case select_set_wait takes
+// Returns SUCCESS, or GEN_ERROR if order is invalid
+enum channel_status select_set_order(select_set_t* set, enum select_order order)
+{
+    if (order > SELECT_ROUND_ROBIN) {
+        return GEN_ERROR;
+    }
+    set->order = order;
+    return SUCCESS;
+}
+
+// Waits on the set like channel_select waits on its list, without registering with the channels again
+// Stores the case that was selected in selected
+// Returns SUCCESS, CLOSED_ERROR if the selected channel is closed, and
+// GEN_ERROR if the set is empty or on any other generic error
+enum channel_status select_set_wait(select_set_t* set, select_t** selected)
+{
+    if (set->count == 0) {
+        return GEN_ERROR;
+    }
+    for (size_t i = 0; i < set->count; i++) {
+        set->cases[i].data = set->entries[i]->data;                                 // Pick up the messages to send now
+        set->cases[i].priority = set->entries[i]->priority;
+    }
+
+    size_t start = select_start(set->order, set->next, &set->seed, set->count);
+    enum channel_status sn = SUCCESS;
+    size_t index = select_poll(set->cases, set->count, start, &sn);
+    unsigned long long since = 0;
+    if (index == set->count) {
+        since = select_clock(set->cases, set->count);
+        sn = select_block(set->cases, set->count, start, set->locks, set->lock_count, &set->subscriber, &index, NULL);
+    }
+    *selected = set->entries[index];
+    set->next = index + 1;
+    if (sn == SUCCESS && (*selected)->dir == RECV) {
+        (*selected)->data = set->cases[index].data;
+    }
+    return select_count(&set->cases[index], sn, since);
+}
+
+// Unregisters the set from its channels and frees it; the entries themselves are left alone
+void select_set_destroy(select_set_t* set)
+{
+    subscriber_destroy(set->cases, set->count, &set->subscriber);
+    free(set->subscriber.waiters);
+    free(set->locks);
+    free(set->cases);
+    free(set->entries);
+    free(set);
+}
+
+// Broadcasts
+// The sender owns tail and publishes a message by storing tail after writing its slot; each cursor
+// owns its position and tells the sender it is done with a slot by storing the next position. The
+// slot of position p can be reused once every cursor is past p, so the sender writes while
+// tail - gate < size, where gate is the slowest cursor as of the sender's last look at all of them.
+// That look and every subscribe take the mutex, and a new cursor starts at tail, so gate never runs
+// ahead of a cursor the sender has not seen yet.
+// Waking works like on the lock-free channels: a thread about to park counts itself in its side's
+// waiters and then re-checks, while the other side publishes and then reads waiters, all sequentially
+// consistent, so at least one of them sees the other. Receivers never touch each other's lines.
+
+struct broadcast_cursor {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t pos;            // Position this subscriber receives next; only its reader writes it
+    broadcast_t* broadcast;
+    struct broadcast_cursor* prev;                          // Links in the broadcast's cursors (mutex held)
+    struct broadcast_cursor* next;
+};
+
+struct broadcast {
+    // sender line
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;           // Position of the next message
+    size_t gate;                                            // Slowest cursor as of the last broadcast_scan
+    atomic_size_t receive_waiters;                          // Receivers parked on not_empty
+    // read on every receive
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t send_waiters;   // Senders parked on not_full
+    size_t size;
+    void** slots;
+    // only used to park, wake and (un)subscribe
+    _Alignas(CACHE_LINE_SIZE) pthread_mutex_t mutex;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    broadcast_cursor_t* cursors;
+    atomic_uchar end_flag;
+};
+
+// Creates a broadcast with the provided (positive) size
+// Returns NULL if the size is 0 or the broadcast could not be allocated
+broadcast_t* broadcast_create(size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+    broadcast_t* broadcast = (broadcast_t*) aligned_alloc(CACHE_LINE_SIZE, sizeof(broadcast_t));
+    if (!broadcast) {
+        return NULL;
+    }
+    broadcast->slots = (void**) malloc(size * sizeof(void*));
+    if (!broadcast->slots) {
+        goto free_broadcast;
+    }
+    if (pthread_mutex_init(&broadcast->mutex, NULL) != 0) {
+        goto free_slots;
+    }
+    if (pthread_cond_init(&broadcast->not_full, NULL) != 0) {
+        goto destroy_mutex;
+    }
+    if (pthread_cond_init(&broadcast->not_empty, NULL) != 0) {
+        pthread_cond_destroy(&broadcast->not_full);
+        goto destroy_mutex;
+    }
+    atomic_init(&broadcast->tail, 0);
+    broadcast->gate = 0;
+    atomic_init(&broadcast->receive_waiters, 0);
+    atomic_init(&broadcast->send_waiters, 0);
+    broadcast->size = size;
+    broadcast->cursors = NULL;
+    atomic_init(&broadcast->end_flag, 0);
+    return broadcast;
+
+destroy_mutex:
+    pthread_mutex_destroy(&broadcast->mutex);
+free_slots:
+    free(broadcast->slots);
+free_broadcast:
+    free(broadcast);
+    return NULL;
+}
+
+// Subscribes to the broadcast; the cursor receives every message sent from now on
+// Returns NULL if the broadcast is closed or memory ran out
+broadcast_cursor_t* broadcast_subscribe(broadcast_t* broadcast)
+{
+    broadcast_cursor_t* cursor = (broadcast_cursor_t*) aligned_alloc(CACHE_LINE_SIZE, sizeof(broadcast_cursor_t));
+    if (!cursor) {
+        return NULL;
+    }
+    pthread_mutex_lock(&broadcast->mutex);
+    if (broadcast->end_flag) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        free(cursor);
+        return NULL;
+    }
+    atomic_init(&cursor->pos, atomic_load(&broadcast->tail));
+    cursor->broadcast = broadcast;
+    cursor->prev = NULL;
+    cursor->next = broadcast->cursors;
+    if (broadcast->cursors) {
+        broadcast->cursors->prev = cursor;
+    }
+    broadcast->cursors = cursor;
+    pthread_mutex_unlock(&broadcast->mutex);
+    return cursor;
+}
+
+// Unsubscribes and frees the cursor; the messages it did not receive no longer hold the sender back
+void broadcast_unsubscribe(broadcast_cursor_t* cursor)
+{
+    broadcast_t* broadcast = cursor->broadcast;
+    pthread_mutex_lock(&broadcast->mutex);
+    if (cursor->prev) {
+        cursor->prev->next = cursor->next;
+    } else {
+        broadcast->cursors = cursor->next;
+    }
+    if (cursor->next) {
+        cursor->next->prev = cursor->prev;
+    }
+    pthread_cond_signal(&broadcast->not_full);              // It may have been the slowest
+    pthread_mutex_unlock(&broadcast->mutex);
+    free(cursor);
+}
+
+// Moves gate up to the slowest cursor (mutex held); with nobody subscribed, nothing holds the sender back
+static void broadcast_scan(broadcast_t* broadcast)
+{
+    size_t gate = atomic_load_explicit(&broadcast->tail, memory_order_relaxed);
+    for (broadcast_cursor_t* cursor = broadcast->cursors; cursor; cursor = cursor->next) {
+        size_t pos = atomic_load(&cursor->pos);
+        if (pos < gate) {
+            gate = pos;
         }
+    }
+    broadcast->gate = gate;
+}
 
-        if (*selected_index == channel_count) {                              // If no channel was selected
-            if (subscriberPtr == NULL) {                                     // If the subscriber object is not created
-                subscriberPtr = subscriber_create(channel_list, channel_count);             // Create a subscriber object
-                if (subscriberPtr == NULL) {                                            // If the subscriber object was not created successfully
-                    return GEN_ERROR;
-                }
-            } else {
-                subscriber_wait(subscriberPtr);                                     // Wait for the subscriber object
+static enum channel_status broadcast_put(broadcast_t* broadcast, void* data, bool blocking)
+{
+    if (broadcast->end_flag) {
+        return CLOSED_ERROR;
+    }
+    size_t tail = atomic_load_explicit(&broadcast->tail, memory_order_relaxed);
+    if (tail - broadcast->gate >= broadcast->size) {                            // Looks full: look at the cursors again
+        pthread_mutex_lock(&broadcast->mutex);
+        broadcast_scan(broadcast);
+        if (blocking && tail - broadcast->gate >= broadcast->size) {
+            atomic_fetch_add(&broadcast->send_waiters, 1);                      // Receivers wake us from here on
+            broadcast_scan(broadcast);
+            while (tail - broadcast->gate >= broadcast->size && !broadcast->end_flag) {
+                pthread_cond_wait(&broadcast->not_full, &broadcast->mutex);
+                broadcast_scan(broadcast);
             }
+            atomic_fetch_sub(&broadcast->send_waiters, 1);
+        }
+        pthread_mutex_unlock(&broadcast->mutex);
+        if (broadcast->end_flag) {
+            return CLOSED_ERROR;
+        }
+        if (tail - broadcast->gate >= broadcast->size) {
+            return CHANNEL_FULL;
+        }
+    }
+    broadcast->slots[tail % broadcast->size] = data;
+    atomic_store(&broadcast->tail, tail + 1);                                   // Publish, then see who is parked
+    if (atomic_load(&broadcast->receive_waiters) > 0) {
+        pthread_mutex_lock(&broadcast->mutex);
+        pthread_cond_broadcast(&broadcast->not_empty);                          // Every subscriber wants this one
+        pthread_mutex_unlock(&broadcast->mutex);
+    }
+    return SUCCESS;
+}
+
+static enum channel_status broadcast_take(broadcast_cursor_t* cursor, void** data, bool blocking)
+{
+    broadcast_t* broadcast = cursor->broadcast;
+    size_t pos = atomic_load_explicit(&cursor->pos, memory_order_relaxed);
+    while (true) {
+        if (broadcast->end_flag) {
+            return CLOSED_ERROR;
         }
-    } while (*selected_index == channel_count);                                     // Loop until a channel is selected
+        if (pos != atomic_load_explicit(&broadcast->tail, memory_order_acquire)) {
+            break;
+        }
+        if (!blocking) {
+            return CHANNEL_EMPTY;
+        }
+        pthread_mutex_lock(&broadcast->mutex);
+        atomic_fetch_add(&broadcast->receive_waiters, 1);                       // The sender wakes us from here on
+        while (pos == atomic_load(&broadcast->tail) && !broadcast->end_flag) {
+            pthread_cond_wait(&broadcast->not_empty, &broadcast->mutex);
+        }
+        atomic_fetch_sub(&broadcast->receive_waiters, 1);
+        pthread_mutex_unlock(&broadcast->mutex);
+    }
+    *data = broadcast->slots[pos % broadcast->size];
+    atomic_store(&cursor->pos, pos + 1);                                        // Hand the slot back, then see who is parked
+    if (atomic_load(&broadcast->send_waiters) > 0) {
+        pthread_mutex_lock(&broadcast->mutex);
+        pthread_cond_signal(&broadcast->not_full);
+        pthread_mutex_unlock(&broadcast->mutex);
+    }
+    return SUCCESS;
+}
+
+// Writes data once for every subscriber, waiting while the slowest of them still has size messages to receive
+// Returns SUCCESS, CLOSED_ERROR if the broadcast is closed
+enum channel_status broadcast_send(broadcast_t* broadcast, void* data)
+{
+    return broadcast_put(broadcast, data, true);
+}
+
+// Same as broadcast_send, but returns CHANNEL_FULL instead of waiting
+enum channel_status broadcast_non_blocking_send(broadcast_t* broadcast, void* data)
+{
+    return broadcast_put(broadcast, data, false);
+}
+
+// Reads the cursor's next message into data, waiting until there is one
+// Returns SUCCESS, or CLOSED_ERROR if the broadcast is closed
+enum channel_status broadcast_receive(broadcast_cursor_t* cursor, void** data)
+{
+    return broadcast_take(cursor, data, true);
+}
 
-    if (subscriberPtr) {
-        subscriber_destroy(channel_list, channel_count, subscriberPtr);             // Destroy the subscriber object
+// Same as broadcast_receive, but returns CHANNEL_EMPTY instead of waiting
+enum channel_status broadcast_non_blocking_receive(broadcast_cursor_t* cursor, void** data)
+{
+    return broadcast_take(cursor, data, false);
+}
+
+// Closes the broadcast and wakes every blocked send and receive to return CLOSED_ERROR
+// Returns SUCCESS, or CLOSED_ERROR if it is already closed
+enum channel_status broadcast_close(broadcast_t* broadcast)
+{
+    pthread_mutex_lock(&broadcast->mutex);
+    if (broadcast->end_flag) {
+        pthread_mutex_unlock(&broadcast->mutex);
+        return CLOSED_ERROR;
     }
+    atomic_store(&broadcast->end_flag, 1);
+    pthread_cond_broadcast(&broadcast->not_full);
+    pthread_cond_broadcast(&broadcast->not_empty);
+    pthread_mutex_unlock(&broadcast->mutex);
+    return SUCCESS;
+}
 
-    return sn;
+// Frees the broadcast, along with the cursors still subscribed
+// Returns SUCCESS, or DESTROY_ERROR if the broadcast is still open
+enum channel_status broadcast_destroy(broadcast_t* broadcast)
+{
+    if (!broadcast->end_flag) {
+        return DESTROY_ERROR;
+    }
+    while (broadcast->cursors) {
+        broadcast_cursor_t* next = broadcast->cursors->next;
+        free(broadcast->cursors);
+        broadcast->cursors = next;
+    }
+    pthread_cond_destroy(&broadcast->not_empty);
+    pthread_cond_destroy(&broadcast->not_full);
+    pthread_mutex_destroy(&broadcast->mutex);
+    free(broadcast->slots);
+    free(broadcast);
+    return SUCCESS;
 }
@@ -9,7 +9,10 @@
 #include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
 #include "linked_list.h"
+#include "histogram.h"
 
 // Defines possible return values from channel functions
 enum channel_status {
@@ -18,25 +21,142 @@ enum channel_status {
     SUCCESS = 1,
     CLOSED_ERROR = -2,
     GEN_ERROR = -1,
-    DESTROY_ERROR = -3
+    DESTROY_ERROR = -3,
+    TIMEOUT = -4
 };
 
-// Defines channel object// Defines channel object
+// Defines the storage backend of a channel
+enum channel_kind {
+    CHANNEL_LOCKED,     // buffer_t protected by the channel mutex (channel_create)
+    CHANNEL_SPSC,       // lock-free single-producer/single-consumer ring (channel_create_spsc)
+    CHANNEL_MPMC,       // lock-free bounded multi-producer/multi-consumer ring (channel_create_mpmc)
+    CHANNEL_UNBUFFERED, // no storage; senders hand values directly to receivers (channel_create(0))
+    CHANNEL_UNBOUNDED,  // buffer_t of linked fixed-size segments, so sends never block (channel_create_unbounded)
+    CHANNEL_PRIORITY,   // buffer_t kept as a heap; receives take the highest priority first (channel_create_priority)
+    CHANNEL_TYPED,      // lock-free ring of fixed-size values copied in and out (channel_create_typed)
+};
+
+// Defines how a blocked send or receive sleeps
+enum channel_park {
+    CHANNEL_PARK_COND,  // pthread condition variables (default)
+    CHANNEL_PARK_FUTEX, // Linux futex on a sequence word; wakers skip the syscall when nobody sleeps
+};
+
+// Defines what a send or receive does while it cannot make progress
+enum channel_wait {
+    CHANNEL_WAIT_BLOCK, // park right away (default)
+    CHANNEL_WAIT_SPIN,  // spin for an adaptive budget, then park; for partners on other cores
+    CHANNEL_WAIT_POLL,  // spin until done and never park; for threads that own a dedicated core
+};
+
+// Options for channel_create_with_attr
+typedef struct {
+    enum channel_kind kind;     // storage backend
+    size_t size;                // capacity (slots per segment for CHANNEL_UNBOUNDED); must be 0 for CHANNEL_UNBUFFERED and positive otherwise
+    enum channel_park park;
+    enum channel_wait wait;
+    size_t elem_size;           // bytes per value; must be positive for CHANNEL_TYPED and is ignored otherwise
+} channel_attr_t;
+
+// Queue of threads blocked on a locked or unbuffered channel (or selects offering a rendezvous),
+// each waiting for the one partner that completes its send or receive
+struct waiter;
+typedef struct {
+    struct waiter* head;
+    struct waiter* tail;
+} waitq_t;
+
+// Threads parked on a lock-free channel until one side frees up: senders wait on not_full, receivers on not_empty
+// The fields the lock-free fast path touches come first, so they share the side's first cache line
+typedef struct {
+    //number of threads parked (or selects subscribed) on a lock-free channel
+    //the lock-free fast path only takes the mutex to wake them when this is non-zero
+    atomic_size_t waiters;
+    //set by the first notifier after a waiter armed itself, so that a burst of operations
+    //wakes the waiters once instead of once per message
+    atomic_bool wake_pending;
+    //CHANNEL_PARK_FUTEX: bumped by every wakeup; parked threads sleep on it instead of cond
+    //(so do CHANNEL_PARK_COND threads with a deadline, counted in timed_waiters)
+    atomic_uint seq;
+    atomic_size_t timed_waiters;
+    //select cases waiting for this side (SEND cases on not_full, RECV cases on not_empty),
+    //linked through the cases' own waiters; an event on one side never wakes the other side's selects
+    struct waiter* subscribers;
+    pthread_cond_t cond;
+} wait_side_t;
+
+// Build with -DCHANNEL_STATS=0 (make STATS=0) to compile the counters of channel_get_stats out of every operation
+#ifndef CHANNEL_STATS
+#define CHANNEL_STATS 1
+#endif
+
+// Counters of one direction of a channel, bumped with relaxed atomics by its senders (or receivers) only
+typedef struct {
+    atomic_size_t ops;          // messages sent (or received)
+    atomic_size_t failed;       // non-blocking calls that found the channel full (or empty)
+    atomic_size_t blocked;      // times a call had to wait for its partner
+    atomic_ullong blocked_ns;   // time spent waiting, spinning included
+    atomic_size_t high_water;   // senders only: most messages the channel was seen holding
+} channel_counters_t;
+
+// Counters of the slow paths, bumped only by threads that park or wake somebody
+typedef struct {
+    atomic_size_t wakeups;
+    atomic_size_t futile_wakeups;
+    atomic_size_t select_notifications;
+} channel_wake_counters_t;
+
+struct channel_latency;
+
+// Defines channel object
+// Laid out in cache lines by who writes them, so threads on different cores share as few lines as possible:
+// the first line is read-mostly, the lock line is only touched with the mutex held or by parking threads,
+// and each wait side is written by the threads that notify it (receivers for not_full, senders for not_empty)
+// Allocated aligned to CACHE_ALIGNMENT, so no other object shares these lines
 typedef struct {
     // DO NOT REMOVE buffer (OR CHANGE ITS NAME) FROM THE STRUCT
     // YOU MUST USE buffer TO STORE YOUR BUFFERED CHANNEL MESSAGES
     buffer_t* buffer;
 
     /* ADD ANY STRUCT ENTRIES YOU NEED HERE */
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
+    //storage backend; buffer is NULL unless kind is CHANNEL_LOCKED, CHANNEL_UNBOUNDED or CHANNEL_PRIORITY
+    enum channel_kind kind;
+    spsc_buffer_t* spsc;
+    mpmc_buffer_t* mpmc;
+    value_buffer_t* typed;
 
-    //closed flag
-    unsigned char end_flag;
+    //how blocked threads sleep, and what they do before that
+    enum channel_park park;
+    enum channel_wait wait;
 
-    //subscribers list for events on this list
-    list_t* subscribers;
+    //closed flag; written once, by channel_close
+    atomic_uchar end_flag;
 
+    //made by channel_create_array, so only channel_destroy_array may free it
+    bool in_array;
+
+    //histograms of channel_attach_latency; NULL until the first attach, then kept until the channel is freed
+    _Atomic(struct channel_latency*) latency;
+
+    //lock line
+    CACHE_ALIGNED pthread_mutex_t mutex;
+
+    //senders and receivers waiting for a partner (every kind but CHANNEL_SPSC, CHANNEL_MPMC and CHANNEL_TYPED)
+    waitq_t sendq;
+    waitq_t recvq;
+
+    //how many rounds a CHANNEL_WAIT_SPIN thread currently spins before parking
+    atomic_uint spin;
+
+    CACHE_ALIGNED wait_side_t not_full;
+    CACHE_ALIGNED wait_side_t not_empty;
+
+#if CHANNEL_STATS
+    //channel_get_stats counters, again on lines of their own by who writes them
+    CACHE_ALIGNED channel_counters_t send_stats;
+    CACHE_ALIGNED channel_counters_t recv_stats;
+    CACHE_ALIGNED channel_wake_counters_t wake_stats;
+#endif
 } channel_t;
 
 // Defines channel list structure for channel_select function
@@ -51,13 +171,62 @@ typedef struct {
     enum direction dir;
     // If dir is RECV, then the message received from the channel is stored as an output in this parameter, data
     // If dir is SEND, then the message that needs to be sent is given as input in this parameter, data
+    // On a CHANNEL_TYPED channel, data points to the value to send, or to elem_size bytes that receive the value
     void* data;
+    // If dir is SEND on a CHANNEL_PRIORITY channel, the priority data is sent with (see channel_send_priority)
+    int priority;
 } select_t;
 
+// Which ready case a select takes when more than one is ready
+enum select_order {
+    SELECT_IN_ORDER,        // The lowest index (the default)
+    SELECT_RANDOM,          // Scans from a random case on every call, so no case can starve the others
+    SELECT_ROUND_ROBIN,     // Scans from the case after the one selected last (select sets only; channel_select_ordered rejects it)
+};
+
 // Creates a new channel with the provided size and returns it to the caller
 // A 0 size indicates an unbuffered channel, whereas a positive size indicates a buffered channel
+// An unbuffered channel allocates no buffer: a send blocks until a receiver takes the value
+// directly from the sender (and vice versa), including sends and receives made by channel_select
 channel_t* channel_create(size_t size);
 
+// Creates a new single-producer/single-consumer channel with the provided (positive) size
+// Send and receive never take the channel mutex unless the ring is full or empty and the caller has to wait
+// The caller guarantees that at most one thread sends and at most one thread receives on the channel
+// (including sends and receives made through channel_select)
+channel_t* channel_create_spsc(size_t size);
+
+// Creates a new multi-producer/multi-consumer channel with the provided (positive) size
+// Any number of threads may send and receive; like an spsc channel, the mutex is only taken
+// to park on a full or empty ring or to wake a parked thread
+channel_t* channel_create_mpmc(size_t size);
+
+#define CHANNEL_SEGMENT_SIZE 256    // Slots per segment of a channel_create_unbounded channel
+
+// Creates a new channel with no capacity limit, for producers that must never block
+// The buffer grows by CHANNEL_SEGMENT_SIZE slots at a time as messages back up, and drained segments
+// are recycled, so memory follows the backlog; a send only fails (with GEN_ERROR) if memory runs out
+// Returns NULL if the channel could not be allocated
+channel_t* channel_create_unbounded(void);
+
+// Creates a new priority channel with the provided (positive) size
+// Every message carries a priority (channel_send_priority; plain sends use 0), and a receive
+// (or select) always takes the pending message of the highest priority, the oldest one among equals
+// Senders that find the channel full still get in in the order they blocked
+channel_t* channel_create_priority(size_t size);
+
+// Creates a new channel of capacity values of elem_size bytes each, stored inline in a lock-free ring
+// like the one of channel_create_mpmc, so small messages (ids, handles, small structs) need no
+// allocation per message: a send copies the value in and a receive copies it out
+// Send with channel_send_value and receive with channel_receive_value; the pointer API works too,
+// with every data pointer (including those of select_t and the batch calls) pointing to a value
+// Returns NULL if either is 0 or the channel could not be allocated
+channel_t* channel_create_typed(size_t elem_size, size_t capacity);
+
+// Creates a new channel as described by attr (storage backend, size and parking mechanism)
+// Returns NULL if attr is invalid or the channel could not be allocated
+channel_t* channel_create_with_attr(const channel_attr_t* attr);
+
 // Writes data to the given channel
 // This is a blocking call i.e., the function only returns on a successful completion of send
 // In case the channel is full, the function waits till the channel has space to write the new data
@@ -74,6 +243,19 @@ enum channel_status channel_send(channel_t* channel, void* data);
 // GEN_ERROR on encountering any other generic error of any sort
 enum channel_status channel_receive(channel_t* channel, void** data);
 
+// Same as channel_send, but a CHANNEL_PRIORITY channel delivers data ahead of every pending message
+// of a lower priority (a larger number is a higher priority); other channels ignore priority
+enum channel_status channel_send_priority(channel_t* channel, void* data, int priority);
+
+// Same as channel_send, but gives up at deadline, an absolute CLOCK_MONOTONIC time (NULL waits forever)
+// Returns TIMEOUT if the message could not be written before the deadline; it was not sent then,
+// and the caller is no longer queued on the channel
+enum channel_status channel_send_until(channel_t* channel, void* data, const struct timespec* deadline);
+
+// Same as channel_receive, but gives up at deadline, an absolute CLOCK_MONOTONIC time (NULL waits forever)
+// Returns TIMEOUT if no message could be read before the deadline
+enum channel_status channel_receive_until(channel_t* channel, void** data, const struct timespec* deadline);
+
 // Writes data to the given channel
 // This is a non-blocking call i.e., the function simply returns if the channel is full
 // Returns SUCCESS for successfully writing data to the channel,
@@ -82,6 +264,9 @@ enum channel_status channel_receive(channel_t* channel, void** data);
 // GEN_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 
+// Same as channel_non_blocking_send, with a priority as in channel_send_priority
+enum channel_status channel_non_blocking_send_priority(channel_t* channel, void* data, int priority);
+
 // Reads data from the given channel and stores it in the function's input parameter data (Note that it is a double pointer)
 // This is a non-blocking call i.e., the function simply returns if the channel is empty
 // Returns SUCCESS for successful retrieval of data,
@@ -90,6 +275,83 @@ enum channel_status channel_non_blocking_send(channel_t* channel, void* data);
 // GEN_ERROR on encountering any other generic error of any sort
 enum channel_status channel_non_blocking_receive(channel_t* channel, void** data);
 
+// Writes up to count messages from data to the given channel, in order
+// This is a blocking call i.e., the function waits till the channel has space for at least one message,
+// then hands messages to receivers already blocked on the channel and writes as many of the rest as fit,
+// under a single lock acquisition
+// Stores the number of messages written in sent
+// Returns SUCCESS for successfully writing at least one message (or count == 0),
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_send_batch(channel_t* channel, void** data, size_t count, size_t* sent);
+
+// Reads up to count messages from the given channel into data, in FIFO order
+// This is a blocking call i.e., the function waits till the channel has at least one message,
+// then reads as many as are available under a single lock acquisition, letting blocked senders into the freed slots
+// Stores the number of messages read in received
+// Returns SUCCESS for successfully reading at least one message (or count == 0),
+// CLOSED_ERROR if the channel is closed, and
+// GEN_ERROR on encountering any other generic error of any sort
+enum channel_status channel_receive_batch(channel_t* channel, void** data, size_t count, size_t* received);
+
+// Copies the elem_size bytes value points to into a CHANNEL_TYPED channel; blocks like channel_send
+// Returns the same as channel_send, and GEN_ERROR if the channel is not a CHANNEL_TYPED channel
+enum channel_status channel_send_value(channel_t* channel, const void* value);
+
+// Copies the oldest value of a CHANNEL_TYPED channel into value (elem_size bytes); blocks like channel_receive
+// Returns the same as channel_receive, and GEN_ERROR if the channel is not a CHANNEL_TYPED channel
+enum channel_status channel_receive_value(channel_t* channel, void* value);
+
+// Same as channel_send_value, but returns CHANNEL_FULL instead of blocking (see channel_non_blocking_send)
+enum channel_status channel_non_blocking_send_value(channel_t* channel, const void* value);
+
+// Same as channel_receive_value, but returns CHANNEL_EMPTY instead of blocking (see channel_non_blocking_receive)
+enum channel_status channel_non_blocking_receive_value(channel_t* channel, void* value);
+
+// A snapshot of a channel's counters since it was created (see channel_get_stats)
+// Operations of a select count on the channel of the case it took
+typedef struct {
+    size_t sends;                   // messages sent
+    size_t receives;                // messages received
+    size_t send_full;               // non-blocking sends that found the channel full
+    size_t receive_empty;           // non-blocking receives that found the channel empty
+    size_t blocked_sends;           // times a send had to wait for room or for a receiver
+    size_t blocked_receives;        // times a receive had to wait for a message
+    unsigned long long blocked_ns;  // total time sends and receives spent waiting
+    size_t wakeups;                 // times a parked send or receive was woken up
+    size_t futile_wakeups;          // wakeups that found the thread still had to wait
+    size_t select_notifications;    // times the channel woke a select waiting on it
+    size_t high_water;              // most messages the channel held at once; sampled every
+                                    // CHANNEL_STATS_SAMPLE sends (and whenever it filled up) on lock-free channels
+} channel_stats_t;
+
+#define CHANNEL_STATS_SAMPLE 64
+
+// Stores a snapshot of the channel's counters in stats; counters keep running while it is taken,
+// so a busy channel's fields may be a few operations apart from each other
+// Returns SUCCESS, or GEN_ERROR if the counters were compiled out (CHANNEL_STATS=0)
+enum channel_status channel_get_stats(channel_t* channel, channel_stats_t* stats);
+
+// Latency histograms to attach to a channel (see histogram.h); any of them may be NULL,
+// and one histogram may be attached to many channels, to see them all together
+// Every time is in nanoseconds of CLOCK_MONOTONIC
+typedef struct {
+    histogram_t* sojourn;   // time from the send of each message to its receive, waiting in the buffer
+                            // or for a partner included; only recorded on CHANNEL_LOCKED and unbuffered channels,
+                            // since the others do not keep their messages in order or under the mutex
+    histogram_t* send;      // time each send (or batch send) that succeeded or timed out spent waiting, 0 if it did not
+    histogram_t* receive;   // the same for receives
+    histogram_t* select;    // time each select that took a case on the channel spent waiting for one
+} channel_latency_t;
+
+// Starts recording into the histograms of latency from now on, in place of those attached before;
+// a NULL latency detaches them all. Operations that already started may still record into the old ones,
+// so only free those once nobody uses the channel any more
+// Recording costs a clock read per message for sojourn times, and nothing but a relaxed add for
+// operations that did not wait; a channel with nothing attached pays a single branch
+// Returns SUCCESS, or GEN_ERROR if memory ran out
+enum channel_status channel_attach_latency(channel_t* channel, const channel_latency_t* latency);
+
 // Closes the channel and informs all the blocking send/receive/select calls to return with CLOSED_ERROR
 // Once the channel is closed, send/receive/select operations will cease to function and just return CLOSED_ERROR
 // Returns SUCCESS if close is successful,
@@ -101,9 +363,21 @@ enum channel_status channel_close(channel_t* channel);
 // The caller is responsible for calling channel_close and waiting for all threads to finish their tasks before calling channel_destroy
 // Returns SUCCESS if destroy is successful,
 // DESTROY_ERROR if channel_destroy is called on an open channel, and
-// GEN_ERROR in any other error case
+// GEN_ERROR in any other error case (including a channel made by channel_create_array)
 enum channel_status channel_destroy(channel_t* channel);
 
+// Creates count channels as channel_create(size) would, for large topologies, with one allocation:
+// the returned table of count pointers, followed by each channel with its buffer and ring right behind it,
+// so setup and teardown cost one malloc/free and a channel's hot state sits on neighbouring pages
+// Returns NULL if count is 0 or the arena could not be allocated
+channel_t** channel_create_array(size_t count, size_t size);
+
+// Frees every channel of a table made by channel_create_array, and the table itself
+// The caller closes every channel and waits for all threads to finish with them first, as for channel_destroy
+// Returns SUCCESS if destroy is successful, and
+// DESTROY_ERROR if any of the channels is still open (nothing is freed then)
+enum channel_status channel_destroy_array(channel_t** channels, size_t count);
+
 // Takes an array of channels (channel_list) of type select_t and the array length (channel_count) as inputs
 // This API iterates over the provided list and finds the set of possible channels which can be used to invoke the required operation (send or receive) specified in select_t
 // If multiple options are available, it selects the first option and performs its corresponding action
@@ -113,4 +387,87 @@ enum channel_status channel_destroy(channel_t* channel);
 // Additionally, selected_index is set to the index of the channel that generated the error
 enum channel_status channel_select(select_t* channel_list, size_t channel_count, size_t* selected_index);
 
+// Same as channel_select, except that if multiple options are available, order decides which one is taken
+// A one-off select keeps no state across calls to round robin on, so SELECT_ROUND_ROBIN needs a select set (select_set_order)
+// Returns GEN_ERROR if order is invalid or SELECT_ROUND_ROBIN, otherwise the same as channel_select
+enum channel_status channel_select_ordered(select_t* channel_list, size_t channel_count, size_t* selected_index, enum select_order order);
+
+// Same as channel_select, but gives up at deadline, an absolute CLOCK_MONOTONIC time (NULL waits forever)
+// Returns TIMEOUT, with selected_index set to channel_count, if no case could complete before the deadline;
+// none of the cases took effect then
+enum channel_status channel_select_until(select_t* channel_list, size_t channel_count, size_t* selected_index, const struct timespec* deadline);
+
+// A select whose cases stay registered with their channels between waits, for callers (such as a
+// router) that select on the same cases over and over; only one thread may use a set at a time
+typedef struct select_set select_set_t;
+
+// Creates an empty select set
+// Returns NULL if the set could not be allocated
+select_set_t* select_set_create(void);
+
+// Adds a case to the set; the set keeps the pointer, so entry must stay valid until it is removed
+// A SEND case sends whatever entry->data holds when select_set_wait is called,
+// and a RECV case stores the message it received in entry->data
+// Returns SUCCESS, or GEN_ERROR if entry is already in the set or memory ran out
+enum channel_status select_set_add(select_set_t* set, select_t* entry);
+
+// Removes a case from the set
+// Returns SUCCESS, or GEN_ERROR if entry is not in the set
+enum channel_status select_set_remove(select_set_t* set, select_t* entry);
+
+// Sets which ready case select_set_wait takes (SELECT_IN_ORDER for a new set)
+// Returns SUCCESS, or GEN_ERROR if order is invalid
+enum channel_status select_set_order(select_set_t* set, enum select_order order);
+
+// Same as channel_select over the cases of the set, in the order they were added and picked as set by select_set_order,
+// except that selected is set to the case that performed the operation (or generated the error)
+// Returns SUCCESS, CLOSED_ERROR if the selected channel is closed, and
+// GEN_ERROR if the set is empty or on any other generic error
+enum channel_status select_set_wait(select_set_t* set, select_t** selected);
+
+// Frees the set; the channels and the entries themselves are left alone
+void select_set_destroy(select_set_t* set);
+
+// A broadcast hands every message to every subscriber: the sender writes each message once into a
+// shared ring, and every subscriber reads it through its own cursor, without contending with the
+// others. A send waits while the slowest subscriber is a whole ring behind.
+// Only one thread may send at a time (as on an spsc channel), and only one thread may use a cursor at a time
+typedef struct broadcast broadcast_t;
+typedef struct broadcast_cursor broadcast_cursor_t;
+
+// Creates a broadcast with the provided (positive) size
+// Returns NULL if the size is 0 or the broadcast could not be allocated
+broadcast_t* broadcast_create(size_t size);
+
+// Subscribes to the broadcast; the cursor receives every message sent from now on
+// Returns NULL if the broadcast is closed or memory ran out
+broadcast_cursor_t* broadcast_subscribe(broadcast_t* broadcast);
+
+// Unsubscribes and frees the cursor; the messages it did not receive no longer hold the sender back
+void broadcast_unsubscribe(broadcast_cursor_t* cursor);
+
+// Writes data once for every subscriber, waiting while the slowest of them still has size messages to receive
+// A message sent while nobody is subscribed is dropped
+// Returns SUCCESS, or CLOSED_ERROR if the broadcast is closed
+enum channel_status broadcast_send(broadcast_t* broadcast, void* data);
+
+// Same as broadcast_send, but returns CHANNEL_FULL instead of waiting
+enum channel_status broadcast_non_blocking_send(broadcast_t* broadcast, void* data);
+
+// Reads the cursor's next message into data, waiting until there is one
+// Returns SUCCESS, or CLOSED_ERROR if the broadcast is closed
+enum channel_status broadcast_receive(broadcast_cursor_t* cursor, void** data);
+
+// Same as broadcast_receive, but returns CHANNEL_EMPTY instead of waiting
+enum channel_status broadcast_non_blocking_receive(broadcast_cursor_t* cursor, void** data);
+
+// Closes the broadcast and wakes every blocked send and receive to return CLOSED_ERROR
+// Returns SUCCESS, or CLOSED_ERROR if it is already closed
+enum channel_status broadcast_close(broadcast_t* broadcast);
+
+// Frees the broadcast, along with the cursors still subscribed
+// The caller closes it first and makes sure no thread still uses it or its cursors
+// Returns SUCCESS, or DESTROY_ERROR if the broadcast is still open
+enum channel_status broadcast_destroy(broadcast_t* broadcast);
+
 #endif // CHANNEL_H
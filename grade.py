@@ -81,26 +81,49 @@ add_test_cases("test_select_response_time", iters_one, timeout_response_time)
 add_test_cases("test_cpu_utilization_select", iters_one, timeout_cpu_utilization)
 add_test_cases("test_cpu_utilization_overall", iters_one, timeout_cpu_utilization)
 add_test_cases("test_for_too_many_wakeups", iters_one, timeout_too_many_wakeups)
-#add_test_case_channel("test_unbuffered", iters_slow)
-#add_test_case_sanitize("test_unbuffered", iters_slow)
-#add_test_case_valgrind("test_unbuffered", iters_slow, timeout_valgrind * 5)
-#add_test_case_channel("test_non_blocking_unbuffered", iters_slow, timeout_channel * 3)
-#add_test_case_sanitize("test_non_blocking_unbuffered", iters_slow, timeout_sanitize * 3)
-#add_test_case_valgrind("test_non_blocking_unbuffered", iters_slow, timeout_valgrind * 3)
-#add_test_cases("test_stress_send_recv_unbuffered", iters_one, timeout_stress_send_recv)
-#add_test_cases("test_select_and_non_blocking_send_unbuffered", iters_slow)
-#add_test_cases("test_select_and_non_blocking_receive_unbuffered", iters_slow)
-#add_test_cases("test_select_with_select_unbuffered", iters_slow)
-#add_test_cases("test_select_with_same_channel_unbuffered")
-#add_test_cases("test_select_with_send_receive_on_same_channel_unbuffered")
-#add_test_cases("test_select_with_duplicate_channel_unbuffered", iters_slow)
-#add_test_cases("test_select_mixed_buffered_unbuffered", iters_slow, timeout_select_mixed_buffered_unbuffered)
-#add_test_case_channel("test_stress_unbuffered", iters_one, timeout_channel * 3)
-#add_test_case_sanitize("test_stress_unbuffered", iters_one, timeout_sanitize * 3)
-#add_test_case_valgrind("test_stress_unbuffered", iters_one, timeout_valgrind * 3)
-#add_test_case_channel("test_stress_mixed_buffered_unbuffered", iters_one, timeout_channel * 3)
-#add_test_case_sanitize("test_stress_mixed_buffered_unbuffered", iters_one, timeout_sanitize * 3)
-#add_test_case_valgrind("test_stress_mixed_buffered_unbuffered", iters_one, timeout_valgrind * 3)
+add_test_cases("test_spsc", iters_slow)
+add_test_cases("test_mpmc", iters_slow)
+add_test_cases("test_batch", iters_slow)
+add_test_cases("test_targeted_wakeups", iters_slow)
+add_test_cases("test_futex", iters_slow)
+add_test_cases("test_wait_policy", iters_one)
+add_test_cases("test_direct_handoff", iters_slow)
+add_test_cases("test_select_set", iters_slow)
+add_test_cases("test_shared_subscribers", iters_slow)
+add_test_cases("test_select_order", iters_slow)
+add_test_cases("test_select_commit", iters_slow)
+add_test_cases("test_select_direction", iters_slow)
+add_test_cases("test_deadline", iters_slow)
+add_test_cases("test_unbounded", iters_slow)
+add_test_cases("test_priority", iters_slow)
+add_test_cases("test_broadcast", iters_slow)
+add_test_cases("test_typed", iters_slow)
+add_test_cases("test_pow2_ring", iters_slow)
+add_test_cases("test_channel_array", iters_slow)
+add_test_cases("test_pool", iters_slow)
+add_test_cases("test_stats", iters_slow)
+add_test_cases("test_trace", iters_slow)
+add_test_cases("test_latency", iters_slow)
+add_test_case_channel("test_unbuffered", iters_slow)
+add_test_case_sanitize("test_unbuffered", iters_slow)
+add_test_case_valgrind("test_unbuffered", iters_slow, timeout_valgrind * 5)
+add_test_case_channel("test_non_blocking_unbuffered", iters_slow, timeout_channel * 3)
+add_test_case_sanitize("test_non_blocking_unbuffered", iters_slow, timeout_sanitize * 3)
+add_test_case_valgrind("test_non_blocking_unbuffered", iters_slow, timeout_valgrind * 3)
+add_test_cases("test_stress_send_recv_unbuffered", iters_one, timeout_stress_send_recv)
+add_test_cases("test_select_and_non_blocking_send_unbuffered", iters_slow)
+add_test_cases("test_select_and_non_blocking_receive_unbuffered", iters_slow)
+add_test_cases("test_select_with_select_unbuffered", iters_slow)
+add_test_cases("test_select_with_same_channel_unbuffered")
+add_test_cases("test_select_with_send_receive_on_same_channel_unbuffered")
+add_test_cases("test_select_with_duplicate_channel_unbuffered", iters_slow)
+add_test_cases("test_select_mixed_buffered_unbuffered", iters_slow, timeout_select_mixed_buffered_unbuffered)
+add_test_case_channel("test_stress_unbuffered", iters_one, timeout_channel * 3)
+add_test_case_sanitize("test_stress_unbuffered", iters_one, timeout_sanitize * 3)
+add_test_case_valgrind("test_stress_unbuffered", iters_one, timeout_valgrind * 3)
+add_test_case_channel("test_stress_mixed_buffered_unbuffered", iters_one, timeout_channel * 3)
+add_test_case_sanitize("test_stress_mixed_buffered_unbuffered", iters_one, timeout_sanitize * 3)
+add_test_case_valgrind("test_stress_mixed_buffered_unbuffered", iters_one, timeout_valgrind * 3)
 
 # Score distribution
 point_breakdown_checkpoint = [
@@ -0,0 +1,141 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "histogram.h"
+
+#define SUB_COUNT (1u << HISTOGRAM_SUB_BITS)                // Buckets per power of two
+#define GROUPS (64 - HISTOGRAM_SUB_BITS + 1)                // Values below SUB_COUNT, then one group per power of two above
+#define BUCKETS (GROUPS * SUB_COUNT)
+
+struct histogram {
+    atomic_ullong counts[BUCKETS];
+    atomic_ullong max;
+};
+
+// Returns the bucket of value: values below SUB_COUNT get one each, and every power of two
+// above is split into SUB_COUNT buckets of equal width
+static size_t bucket_of(uint64_t value)
+{
+    if (value < SUB_COUNT) {
+        return (size_t) value;
+    }
+    unsigned int shift = (unsigned int) (63 - __builtin_clzll(value)) - HISTOGRAM_SUB_BITS;
+    return (size_t) (shift + 1) * SUB_COUNT + (size_t) ((value >> shift) - SUB_COUNT);
+}
+
+// Returns the largest value that falls into bucket
+static uint64_t bucket_top(size_t bucket)
+{
+    size_t group = bucket / SUB_COUNT;
+    uint64_t sub = bucket % SUB_COUNT;
+    if (group == 0) {
+        return sub;
+    }
+    unsigned int shift = (unsigned int) group - 1;
+    return ((SUB_COUNT + sub) << shift) + ((1ull << shift) - 1);
+}
+
+// Creates an empty histogram
+histogram_t* histogram_create(void)
+{
+    histogram_t* histogram = malloc(sizeof(histogram_t));
+    if (histogram) {
+        histogram_reset(histogram);
+    }
+    return histogram;
+}
+
+// Frees the histogram
+void histogram_free(histogram_t* histogram)
+{
+    free(histogram);
+}
+
+// Counts one occurrence of value
+void histogram_record(histogram_t* histogram, uint64_t value)
+{
+    atomic_fetch_add_explicit(&histogram->counts[bucket_of(value)], 1, memory_order_relaxed);
+    unsigned long long seen = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (value > seen && !atomic_compare_exchange_weak_explicit(&histogram->max, &seen, value,
+                                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Adds every count of from to into
+void histogram_merge(histogram_t* into, const histogram_t* from)
+{
+    for (size_t i = 0; i < BUCKETS; i++) {
+        unsigned long long count = atomic_load_explicit(&((histogram_t*) from)->counts[i], memory_order_relaxed);
+        if (count > 0) {
+            atomic_fetch_add_explicit(&into->counts[i], count, memory_order_relaxed);
+        }
+    }
+    unsigned long long max = atomic_load_explicit(&((histogram_t*) from)->max, memory_order_relaxed);
+    unsigned long long seen = atomic_load_explicit(&into->max, memory_order_relaxed);
+    while (max > seen && !atomic_compare_exchange_weak_explicit(&into->max, &seen, max, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Forgets every value recorded so far
+void histogram_reset(histogram_t* histogram)
+{
+    for (size_t i = 0; i < BUCKETS; i++) {
+        atomic_store_explicit(&histogram->counts[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+}
+
+// Returns how many values were recorded
+uint64_t histogram_count(const histogram_t* histogram)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        total += atomic_load_explicit(&((histogram_t*) histogram)->counts[i], memory_order_relaxed);
+    }
+    return total;
+}
+
+// Returns the largest value recorded, or 0 if none was
+uint64_t histogram_max(const histogram_t* histogram)
+{
+    return atomic_load_explicit(&((histogram_t*) histogram)->max, memory_order_relaxed);
+}
+
+// Returns the value at or below which percentile percent of the recorded values lie, rounded up to the top of its bucket
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile)
+{
+    uint64_t total = histogram_count(histogram);
+    if (total == 0) {
+        return 0;
+    }
+    double rank = percentile / 100.0 * (double) total;
+    uint64_t target = rank < 1.0 ? 1 : (uint64_t) rank;
+    if ((double) target < rank) {
+        target++;                                                   // The rank-th value, rounded up
+    }
+    if (target > total) {
+        target = total;
+    }
+    uint64_t max = histogram_max(histogram);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += atomic_load_explicit(&((histogram_t*) histogram)->counts[i], memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t top = bucket_top(i);
+            return top < max ? top : max;                           // No value above the largest one recorded
+        }
+    }
+    return max;                                                     // Values recorded while we counted
+}
+
+// Writes the count and the usual percentiles of the histogram to file
+void histogram_print(const histogram_t* histogram, const char* name, FILE* file)
+{
+    fprintf(file, "%-16s count %10llu  p50 %10llu  p90 %10llu  p99 %10llu  p99.9 %10llu  p99.99 %10llu  max %10llu\n", name,
+            (unsigned long long) histogram_count(histogram),
+            (unsigned long long) histogram_percentile(histogram, 50.0),
+            (unsigned long long) histogram_percentile(histogram, 90.0),
+            (unsigned long long) histogram_percentile(histogram, 99.0),
+            (unsigned long long) histogram_percentile(histogram, 99.9),
+            (unsigned long long) histogram_percentile(histogram, 99.99),
+            (unsigned long long) histogram_max(histogram));
+}
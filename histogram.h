@@ -0,0 +1,46 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// HDR-style latency histogram: values (nanoseconds, say) are counted in log-linear buckets, 2^HISTOGRAM_SUB_BITS
+// buckets per power of two, so every value from 0 to UINT64_MAX fits in a fixed array and comes back
+// from histogram_percentile within 1 / 2^HISTOGRAM_SUB_BITS (about 3%) of what was recorded.
+// Recording is one relaxed atomic add, so any number of threads may record into one histogram;
+// threads can also keep histograms of their own and histogram_merge them afterwards.
+
+#define HISTOGRAM_SUB_BITS 5
+
+typedef struct histogram histogram_t;
+
+// Creates an empty histogram
+// Returns NULL if memory ran out
+histogram_t* histogram_create(void);
+
+// Frees the histogram
+void histogram_free(histogram_t* histogram);
+
+// Counts one occurrence of value
+void histogram_record(histogram_t* histogram, uint64_t value);
+
+// Adds every count of from to into; from is left alone
+void histogram_merge(histogram_t* into, const histogram_t* from);
+
+// Forgets every value recorded so far
+void histogram_reset(histogram_t* histogram);
+
+// Returns how many values were recorded
+uint64_t histogram_count(const histogram_t* histogram);
+
+// Returns the largest value recorded (exactly), or 0 if none was
+uint64_t histogram_max(const histogram_t* histogram);
+
+// Returns the value at or below which percentile percent of the recorded values lie (say 99.9 for p99.9),
+// rounded up to the top of its bucket, or 0 if no value was recorded
+uint64_t histogram_percentile(const histogram_t* histogram, double percentile);
+
+// Writes one line with the count, p50, p90, p99, p99.9, p99.99 and max of the histogram to file, labelled name
+void histogram_print(const histogram_t* histogram, const char* name, FILE* file);
+
+#endif // HISTOGRAM_H
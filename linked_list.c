@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "linked_list.h"
+#include "pool.h"
 
 //Linkedlist Refference: https://www.geeksforgeeks.org/applications-advantages-and-disadvantages-of-linked-list/?ref=lbp
 
@@ -25,7 +26,7 @@ static void list_clear(list_t * list){
   while(iter){
     list_node_t * next = iter->next;                 //set next to iter->next
 
-    free(iter);                                      //free iter
+    pool_free(iter, sizeof(list_node_t));            //free iter
 
     iter = next;
   }
@@ -87,9 +88,9 @@ void list_insert(list_t* list, void* data)
       return;
     }
 
-    //allocate a new node
-    list_node_t * node = (list_node_t *) malloc(sizeof(list_node_t));
-    if(node == NULL){                        //malloc returns NULL if it fails to allocate memory   
+    //allocate a new node from the thread's pool, so steady insert/remove cycles never reach malloc
+    list_node_t * node = (list_node_t *) pool_alloc(sizeof(list_node_t));
+    if(node == NULL){                        //pool_alloc returns NULL if it fails to allocate memory
       return;
     }
 
@@ -129,6 +130,7 @@ void list_remove(list_t* list, list_node_t* node)
   }
 
   list->count--;
+  pool_free(node, sizeof(list_node_t));                     //free node
 }
 
 // Executes a function for each element in the list
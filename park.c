@@ -0,0 +1,49 @@
+#include <errno.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "park.h"
+
+// Blocks the calling thread while *word == seen
+// The kernel re-checks the word under its own lock, so a wake issued after the
+// word changed can never be missed
+void park_wait(atomic_uint* word, unsigned int seen)
+{
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);   // EAGAIN/EINTR are spurious returns
+}
+
+// Wakes up to count threads blocked in park_wait on word
+void park_wake(atomic_uint* word, int count)
+{
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// Wakes every thread blocked in park_wait on word
+void park_wake_all(atomic_uint* word)
+{
+    park_wake(word, INT_MAX);
+}
+
+// Returns true once deadline has passed
+bool park_deadline_passed(const struct timespec* deadline)
+{
+    if (!deadline) {
+        return false;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+// Same as park_wait, but also returns once deadline has passed
+// FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout, so no remaining time is computed
+bool park_wait_until(atomic_uint* word, unsigned int seen, const struct timespec* deadline)
+{
+    if (!deadline) {
+        park_wait(word, seen);
+        return true;
+    }
+    long rc = syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_BITSET_PRIVATE, seen, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+    return !(rc == -1 && errno == ETIMEDOUT);
+}
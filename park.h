@@ -0,0 +1,40 @@
+#ifndef PARK_H
+#define PARK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+// Thin wait/wake layer over Linux futexes
+// A waiter sleeps on a 32-bit word for as long as the word still holds the value it last saw;
+// a waker changes the word first and then wakes sleepers. Nothing here allocates or locks.
+
+// Blocks the calling thread while *word == seen
+// May return spuriously; callers re-check their condition in a loop
+void park_wait(atomic_uint* word, unsigned int seen);
+
+// Wakes up to count threads blocked in park_wait on word
+void park_wake(atomic_uint* word, int count);
+
+// Wakes every thread blocked in park_wait on word
+void park_wake_all(atomic_uint* word);
+
+// Deadlines are absolute CLOCK_MONOTONIC times; a NULL deadline never passes
+
+// Returns true once deadline has passed
+bool park_deadline_passed(const struct timespec* deadline);
+
+// Same as park_wait, but also returns once deadline has passed
+// Returns false if it returned because the deadline passed
+bool park_wait_until(atomic_uint* word, unsigned int seen, const struct timespec* deadline);
+
+// Tells the CPU the caller is busy-waiting, so a sibling hyperthread gets the core meanwhile
+static inline void park_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+#endif // PARK_H
@@ -0,0 +1,163 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "pool.h"
+
+#define POOL_CLASSES 10                     // 32, 64, ... 16384 bytes
+
+// Free block, linked through its first bytes
+typedef struct pool_block {
+    struct pool_block* next;
+} pool_block_t;
+
+typedef struct {
+    pool_block_t* blocks;
+    size_t count;
+} pool_list_t;
+
+static pool_list_t shared[POOL_CLASSES];                    // Guarded by shared_mutex
+static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_size_t heap_allocations;
+
+static __thread pool_list_t cache[POOL_CLASSES];
+static __thread bool cache_registered;                      // The key's destructor runs for this thread
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+// Returns the size class of a block of size bytes, or POOL_CLASSES if it is too large for the pool
+static size_t pool_class(size_t size)
+{
+    size_t class = 0;
+    for (size_t block = POOL_MIN_BLOCK; block < size; block <<= 1) {
+        if (++class == POOL_CLASSES) {
+            break;
+        }
+    }
+    return class;
+}
+
+// Moves every block of a thread's cache to the shared lists when the thread exits
+static void cache_flush(void* arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&shared_mutex);
+    for (size_t class = 0; class < POOL_CLASSES; class++) {
+        while (cache[class].blocks) {
+            pool_block_t* block = cache[class].blocks;
+            cache[class].blocks = block->next;
+            if (shared[class].count < POOL_SHARED_BLOCKS) {
+                block->next = shared[class].blocks;
+                shared[class].blocks = block;
+                shared[class].count++;
+            } else {
+                free(block);
+            }
+        }
+        cache[class].count = 0;
+    }
+    pthread_mutex_unlock(&shared_mutex);
+}
+
+static void cache_key_create(void)
+{
+    pthread_key_create(&cache_key, cache_flush);
+}
+
+// Makes sure the thread's cache is flushed when it exits, before the first block goes into it
+static void cache_register(void)
+{
+    pthread_once(&cache_key_once, cache_key_create);
+    pthread_setspecific(cache_key, &cache_registered);          // Any non-NULL value runs the destructor
+    cache_registered = true;
+}
+
+// Returns a block of at least size bytes, aligned like malloc, or NULL if memory ran out
+void* pool_alloc(size_t size)
+{
+    size_t class = pool_class(size);
+    if (class == POOL_CLASSES) {
+        atomic_fetch_add_explicit(&heap_allocations, 1, memory_order_relaxed);
+        return malloc(size);
+    }
+    pool_block_t* block = cache[class].blocks;
+    if (block) {                                                // Fast path: the thread's own cache
+        cache[class].blocks = block->next;
+        cache[class].count--;
+        return block;
+    }
+    pthread_mutex_lock(&shared_mutex);
+    block = shared[class].blocks;
+    if (block) {
+        shared[class].blocks = block->next;
+        shared[class].count--;
+    }
+    pthread_mutex_unlock(&shared_mutex);
+    if (block) {
+        return block;
+    }
+    atomic_fetch_add_explicit(&heap_allocations, 1, memory_order_relaxed);
+    return malloc((size_t)POOL_MIN_BLOCK << class);
+}
+
+// Returns a block from pool_alloc; size must be the size it was allocated with
+void pool_free(void* block, size_t size)
+{
+    if (block == NULL) {
+        return;
+    }
+    size_t class = pool_class(size);
+    if (class == POOL_CLASSES) {
+        free(block);
+        return;
+    }
+    if (!cache_registered) {
+        cache_register();
+    }
+    pool_block_t* node = block;
+    if (cache[class].count < POOL_CACHE_BLOCKS) {
+        node->next = cache[class].blocks;
+        cache[class].blocks = node;
+        cache[class].count++;
+        return;
+    }
+    pthread_mutex_lock(&shared_mutex);                          // Overflow: let other threads have it
+    if (shared[class].count < POOL_SHARED_BLOCKS) {
+        node->next = shared[class].blocks;
+        shared[class].blocks = node;
+        shared[class].count++;
+        node = NULL;
+    }
+    pthread_mutex_unlock(&shared_mutex);
+    free(node);
+}
+
+// Returns how many blocks pool_alloc has taken from malloc so far, across all threads
+size_t pool_heap_allocations(void)
+{
+    return atomic_load_explicit(&heap_allocations, memory_order_relaxed);
+}
+
+// Frees every block of list and empties it
+static void list_drain(pool_list_t* list)
+{
+    while (list->blocks) {
+        pool_block_t* block = list->blocks;
+        list->blocks = block->next;
+        free(block);
+    }
+    list->count = 0;
+}
+
+// Frees every block cached by the calling thread and every block on the shared lists
+void pool_cleanup(void)
+{
+    for (size_t class = 0; class < POOL_CLASSES; class++) {
+        list_drain(&cache[class]);
+    }
+    pthread_mutex_lock(&shared_mutex);
+    for (size_t class = 0; class < POOL_CLASSES; class++) {
+        list_drain(&shared[class]);
+    }
+    pthread_mutex_unlock(&shared_mutex);
+}
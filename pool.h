@@ -0,0 +1,33 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Thread-caching allocator for the small blocks channel operations need over and over
+// (list nodes, the waiters of a large select)
+// Blocks come in power-of-two size classes from POOL_MIN_BLOCK to POOL_MAX_BLOCK bytes. Every thread
+// keeps up to POOL_CACHE_BLOCKS free blocks per class, so a steady alloc/free loop never leaves the
+// thread or takes a lock; a cache that overflows, or whose thread exits, hands its blocks to a shared
+// list per class, and only when that is empty too does pool_alloc fall back to malloc
+// Larger blocks go straight to malloc and free
+
+#define POOL_MIN_BLOCK 32
+#define POOL_MAX_BLOCK 16384
+#define POOL_CACHE_BLOCKS 32                // per thread and class
+#define POOL_SHARED_BLOCKS 256              // per class; any more are freed
+
+// Returns a block of at least size bytes, aligned like malloc, or NULL if memory ran out
+void* pool_alloc(size_t size);
+
+// Returns a block from pool_alloc; size must be the size it was allocated with
+void pool_free(void* block, size_t size);
+
+// Returns how many blocks pool_alloc has taken from malloc so far (large ones included), across all threads
+// A loop that allocates nothing new in steady state leaves this unchanged
+size_t pool_heap_allocations(void);
+
+// Frees every block cached by the calling thread and every block on the shared lists
+// Blocks still cached by other live threads stay theirs; the pool keeps working afterwards
+void pool_cleanup(void);
+
+#endif // POOL_H
@@ -307,12 +307,8 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     enum channel_status status;
     bool initialized = create_topology(filename);
     assert(initialized);
-    channels = malloc(sizeof(channel_t*) * num_channel);
+    channels = channel_create_array(num_channel, main_buffer_size);    // One arena for every router's channel
     assert(channels != NULL);
-    for (size_t i = 0; i < num_channel; i++) {
-        channels[i] = channel_create(main_buffer_size);
-        assert(channels[i] != NULL);
-    }
     done_channel = channel_create(secondary_buffer_size);
     assert(done_channel != NULL);
     completed_channel = channel_create(secondary_buffer_size);
@@ -347,10 +343,9 @@ void run_stress(size_t main_buffer_size, size_t secondary_buffer_size, const cha
     for (size_t i = 0; i < num_channel; i++) {
         status = channel_close(channels[i]);
         assert(status == SUCCESS);
-        status = channel_destroy(channels[i]);
-        assert(status == SUCCESS);
     }
+    status = channel_destroy_array(channels, num_channel);
+    assert(status == SUCCESS);
     free(pid);
-    free(channels);
     destroy_topology();
 }
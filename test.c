@@ -10,6 +10,10 @@
 #include <stdbool.h>
 #include "stress.h"
 #include "stress_send_recv.h"
+#include "linked_list.h"
+#include "pool.h"
+#include "trace.h"
+#include "histogram.h"
 
 #define mu_str_(text) #text
 #define mu_str(text) mu_str_(text)
@@ -44,6 +48,14 @@ typedef struct {
     pthread_t pid;
 } cpu_args;
 
+typedef struct {
+    channel_t *channel;
+    size_t count;
+    enum channel_status out;
+    size_t first;
+    void **received;
+} stream_args;
+
 int tests_run = 0;
 int tests_passed = 0;
 
@@ -115,6 +127,22 @@ void* helper_non_blocking_send(send_args *myargs) {
     return NULL;
 }
 
+void* helper_send_sequence(stream_args *myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 1; i <= myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_send(myargs->channel, (void*)(myargs->first + i));
+    }
+    return NULL;
+}
+
+void* helper_receive_sequence(stream_args *myargs) {
+    myargs->out = SUCCESS;
+    for (size_t i = 0; i < myargs->count && myargs->out == SUCCESS; i++) {
+        myargs->out = channel_receive(myargs->channel, &myargs->received[i]);
+    }
+    return NULL;
+}
+
 void* helper_non_blocking_receive(receive_args* myargs) {
     myargs->out = channel_non_blocking_receive(myargs->channel, &myargs->data);
     if (myargs->done) {
@@ -2020,6 +2048,1680 @@ char* test_select_mixed_buffered_unbuffered() {
     return NULL;
 }
 
+char* test_spsc() {
+    print_test_details(__func__, "Testing single-producer/single-consumer channels");
+
+    size_t capacity = 3;
+    size_t MESSAGES = 10000;
+    channel_t* channel = channel_create_spsc(capacity);
+    mu_assert("test_spsc: Could not create channel", channel != NULL);
+    mu_assert("test_spsc: Size 0 should be rejected", channel_create_spsc(0) == NULL);
+
+    /* Fill the ring with non-blocking calls and drain it again in FIFO order */
+    for (size_t i = 1; i <= capacity; i++) {
+        mu_assert("test_spsc: Non-blocking send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_spsc: Send on a full channel should fail", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+    for (size_t i = 1; i <= capacity; i++) {
+        void* data = NULL;
+        mu_assert("test_spsc: Non-blocking receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_spsc: Wrong order", (size_t)data == i);
+    }
+    void* data = NULL;
+    mu_assert("test_spsc: Receive on an empty channel should fail", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    /* Stream through the small ring so both sides have to park */
+    pthread_t pid;
+    stream_args args = {channel, MESSAGES, GEN_ERROR, 0, NULL};
+    pthread_create(&pid, NULL, (void *)helper_send_sequence, &args);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_spsc: Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("test_spsc: Wrong order", (size_t)data == i);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_spsc: Send failed", args.out == SUCCESS);
+
+    /* Select wakes up on a lock-free channel */
+    select_t list[1];
+    list[0].dir = RECV;
+    list[0].channel = channel;
+    list[0].data = NULL;
+    select_args sargs;
+    init_object_for_select_api(&sargs, list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &sargs);
+    usleep(10000);
+    mu_assert("test_spsc: Select isn't blocked as expected", sargs.out == GEN_ERROR);
+    mu_assert("test_spsc: Non-blocking send failed", channel_non_blocking_send(channel, "Message") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_spsc: Select failed", sargs.out == SUCCESS);
+    mu_assert("test_spsc: Wrong message", string_equal(list[0].data, "Message"));
+
+    /* A parked receiver is released by close */
+    receive_args rargs;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_spsc: Receive isn't blocked as expected", rargs.out == GEN_ERROR);
+    mu_assert("test_spsc: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_spsc: Receive should see the close", rargs.out == CLOSED_ERROR);
+    mu_assert("test_spsc: Send should see the close", channel_send(channel, "Message") == CLOSED_ERROR);
+
+    mu_assert("test_spsc: Destroy failed", channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+char* test_mpmc() {
+    print_test_details(__func__, "Testing multi-producer/multi-consumer channels");
+
+    size_t capacity = 5;
+    size_t THREADS = 4;
+    size_t MESSAGES = 2500;
+    channel_t* channel = channel_create_mpmc(capacity);
+    mu_assert("test_mpmc: Could not create channel", channel != NULL);
+
+    for (size_t i = 1; i <= capacity; i++) {
+        mu_assert("test_mpmc: Non-blocking send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_mpmc: Send on a full channel should fail", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+    for (size_t i = 1; i <= capacity; i++) {
+        void* data = NULL;
+        mu_assert("test_mpmc: Non-blocking receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_mpmc: Wrong order", (size_t)data == i);
+    }
+    void* data = NULL;
+    mu_assert("test_mpmc: Receive on an empty channel should fail", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    /* Several producers and consumers; every message must arrive exactly once */
+    pthread_t send_pid[THREADS], rec_pid[THREADS];
+    stream_args send_args_[THREADS], rec_args[THREADS];
+    void** received = malloc(sizeof(void*) * THREADS * MESSAGES);
+    bool* seen = calloc(THREADS * MESSAGES + 1, sizeof(bool));
+    for (size_t i = 0; i < THREADS; i++) {
+        rec_args[i] = (stream_args){channel, MESSAGES, GEN_ERROR, 0, &received[i * MESSAGES]};
+        pthread_create(&rec_pid[i], NULL, (void *)helper_receive_sequence, &rec_args[i]);
+        send_args_[i] = (stream_args){channel, MESSAGES, GEN_ERROR, i * MESSAGES, NULL};
+        pthread_create(&send_pid[i], NULL, (void *)helper_send_sequence, &send_args_[i]);
+    }
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(send_pid[i], NULL);
+        pthread_join(rec_pid[i], NULL);
+    }
+    bool valid = true;
+    for (size_t i = 0; i < THREADS; i++) {
+        valid = valid && send_args_[i].out == SUCCESS && rec_args[i].out == SUCCESS;
+    }
+    for (size_t i = 0; valid && i < THREADS * MESSAGES; i++) {
+        size_t value = (size_t)received[i];
+        valid = (1 <= value) && (value <= THREADS * MESSAGES) && !seen[value];
+        seen[value] = true;
+    }
+    free(received);
+    free(seen);
+    mu_assert("test_mpmc: Messages were lost or duplicated", valid);
+
+    /* A parked sender is released by close */
+    for (size_t i = 0; i < capacity; i++) {
+        channel_send(channel, "Message");
+    }
+    pthread_t pid;
+    send_args sargs;
+    init_object_for_send_api(&sargs, channel, "Message", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &sargs);
+    usleep(10000);
+    mu_assert("test_mpmc: Send isn't blocked as expected", sargs.out == GEN_ERROR);
+    mu_assert("test_mpmc: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_mpmc: Send should see the close", sargs.out == CLOSED_ERROR);
+
+    mu_assert("test_mpmc: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* A single slot is full after one send */
+    channel = channel_create_mpmc(1);
+    mu_assert("test_mpmc: Could not create channel", channel != NULL);
+    for (size_t i = 1; i <= 3; i++) {
+        mu_assert("test_mpmc: Non-blocking send failed", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+        mu_assert("test_mpmc: Send on a full channel should fail", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+        mu_assert("test_mpmc: Non-blocking receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        mu_assert("test_mpmc: Wrong message", (size_t)data == i);
+    }
+    mu_assert("test_mpmc: Close failed", channel_close(channel) == SUCCESS);
+    mu_assert("test_mpmc: Destroy failed", channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+char* test_batch_channel(channel_t* channel, size_t capacity) {
+    void* items[8] = {(void*)1, (void*)2, (void*)3, (void*)4, (void*)5, (void*)6, (void*)7, (void*)8};
+    void* out[8];
+    size_t sent = 0, received = 0;
+
+    /* Only as many messages as fit are sent */
+    mu_assert("test_batch: Send batch failed", channel_send_batch(channel, items, 8, &sent) == SUCCESS);
+    mu_assert("test_batch: Sent more than the capacity", sent == capacity);
+    mu_assert("test_batch: Receive batch failed", channel_receive_batch(channel, out, 3, &received) == SUCCESS);
+    mu_assert("test_batch: Received wrong count", received == 3);
+    for (size_t i = 0; i < received; i++) {
+        mu_assert("test_batch: Wrong order", out[i] == items[i]);
+    }
+
+    /* The next batch wraps around the end of the ring */
+    mu_assert("test_batch: Send batch failed", channel_send_batch(channel, &items[sent], 8 - sent, &sent) == SUCCESS);
+    mu_assert("test_batch: Sent wrong count", sent == 3);
+    mu_assert("test_batch: Receive batch failed", channel_receive_batch(channel, out, 8, &received) == SUCCESS);
+    mu_assert("test_batch: Received wrong count", received == capacity);
+    for (size_t i = 0; i < received; i++) {
+        mu_assert("test_batch: Wrong order across wraparound", out[i] == items[i + 3]);
+    }
+
+    /* A blocked batch receive is woken by a send */
+    pthread_t pid;
+    receive_args args;
+    init_object_for_receive_api(&args, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &args);
+    usleep(10000);
+    mu_assert("test_batch: Receive isn't blocked as expected", args.out == GEN_ERROR);
+    mu_assert("test_batch: Send batch failed", channel_send_batch(channel, items, 1, &sent) == SUCCESS && sent == 1);
+    pthread_join(pid, NULL);
+    mu_assert("test_batch: Receive failed", args.out == SUCCESS && args.data == items[0]);
+
+    channel_close(channel);
+    mu_assert("test_batch: Send batch should see the close", channel_send_batch(channel, items, 1, &sent) == CLOSED_ERROR && sent == 0);
+    mu_assert("test_batch: Receive batch should see the close", channel_receive_batch(channel, out, 1, &received) == CLOSED_ERROR && received == 0);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_batch() {
+    print_test_details(__func__, "Testing batch send and receive");
+    size_t capacity = 5;
+    char* result = test_batch_channel(channel_create(capacity), capacity);
+    if (result == NULL) {
+        result = test_batch_channel(channel_create_spsc(capacity), capacity);
+    }
+    if (result == NULL) {
+        result = test_batch_channel(channel_create_mpmc(capacity), capacity);
+    }
+    return result;
+}
+
+char* test_targeted_wakeups_channel(channel_t* channel) {
+    /* 32 receivers are blocked on the channel; every send must wake one of them, not all of them.
+     * Counts the context switches of the whole process per message.
+     */
+    size_t THREADS = 32;
+    pthread_t pid[THREADS];
+    receive_args args[THREADS];
+
+    sem_t done;
+    sem_init(&done, 0, 0);
+
+    for (size_t i = 0; i < THREADS; i++) {
+        init_object_for_receive_api(&args[i], channel, &done);
+        pthread_create(&pid[i], NULL, (void *)helper_receive, &args[i]);
+    }
+
+    usleep(10000);
+
+    struct rusage usage1;
+    getrusage(RUSAGE_SELF, &usage1);
+
+    for (size_t i = 0; i < THREADS; i++) {
+        mu_assert("test_targeted_wakeups: Incorrect status", channel_send(channel, "Message") == SUCCESS);
+        sem_wait(&done);
+    }
+
+    struct rusage usage2;
+    getrusage(RUSAGE_SELF, &usage2);
+    long switches = (usage2.ru_nvcsw - usage1.ru_nvcsw) + (usage2.ru_nivcsw - usage1.ru_nivcsw);
+    mu_assert("test_targeted_wakeups: Too many context switches per message", switches < (long)THREADS * 8);
+
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(pid[i], NULL);
+        mu_assert("test_targeted_wakeups: Incorrect status", args[i].out == SUCCESS);
+        mu_assert("test_targeted_wakeups: Incorrect message", string_equal(args[i].data, "Message"));
+    }
+
+    sem_destroy(&done);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_targeted_wakeups() {
+    print_test_details(__func__, "Testing that a send wakes one blocked receiver, not all of them");
+    char* result = test_targeted_wakeups_channel(channel_create(1));
+    if (result == NULL) {
+        result = test_targeted_wakeups_channel(channel_create(0));
+    }
+    return result;
+}
+
+// Streams messages through a channel created from attr, then checks close releases a blocked receiver
+char* check_attr_channel(channel_attr_t attr) {
+    size_t MESSAGES = 1000;
+    channel_t* channel = channel_create_with_attr(&attr);
+    mu_assert("Could not create channel", channel != NULL);
+
+    /* A tiny (or no) buffer makes both sides wait on nearly every message */
+    pthread_t pid;
+    void* data = NULL;
+    stream_args args = {channel, MESSAGES, GEN_ERROR, 0, NULL};
+    pthread_create(&pid, NULL, (void *)helper_send_sequence, &args);
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("Receive failed", channel_receive(channel, &data) == SUCCESS);
+        mu_assert("Wrong order", (size_t)data == i);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("Send failed", args.out == SUCCESS);
+
+    /* A waiting receiver is released by close */
+    receive_args rargs;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("Receive isn't blocked as expected", rargs.out == GEN_ERROR);
+    mu_assert("Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("Receive should see the close", rargs.out == CLOSED_ERROR);
+
+    mu_assert("Destroy failed", channel_destroy(channel) == SUCCESS);
+    return NULL;
+}
+
+char* test_futex() {
+    print_test_details(__func__, "Testing channels that park on a futex");
+
+    channel_attr_t bad[] = {{CHANNEL_LOCKED, 0, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                            {CHANNEL_UNBUFFERED, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                            {CHANNEL_MPMC, 1, (enum channel_park)7, CHANNEL_WAIT_BLOCK}};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        mu_assert("test_futex: Invalid attributes should be rejected", channel_create_with_attr(&bad[i]) == NULL);
+    }
+
+    channel_attr_t attrs[] = {{CHANNEL_LOCKED, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_SPSC, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_MPMC, 2, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_UNBUFFERED, 0, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK}};
+    for (size_t k = 0; k < sizeof(attrs) / sizeof(attrs[0]); k++) {
+        char* result = check_attr_channel(attrs[k]);
+        if (result) {
+            return result;
+        }
+    }
+    return NULL;
+}
+
+char* test_wait_policy() {
+    print_test_details(__func__, "Testing channels that spin before parking, or busy-poll");
+
+    channel_attr_t bad = {CHANNEL_LOCKED, 1, CHANNEL_PARK_COND, (enum channel_wait)7};
+    mu_assert("test_wait_policy: Invalid wait policy should be rejected", channel_create_with_attr(&bad) == NULL);
+
+    enum channel_kind kinds[] = {CHANNEL_LOCKED, CHANNEL_SPSC, CHANNEL_MPMC, CHANNEL_UNBUFFERED};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        for (enum channel_wait wait = CHANNEL_WAIT_SPIN; wait <= CHANNEL_WAIT_POLL; wait++) {
+            for (enum channel_park park = CHANNEL_PARK_COND; park <= CHANNEL_PARK_FUTEX; park++) {
+                if (wait == CHANNEL_WAIT_POLL && park == CHANNEL_PARK_FUTEX) {
+                    continue;                                   // Polling threads never park, so one park is enough
+                }
+                channel_attr_t attr = {kinds[k], kinds[k] == CHANNEL_UNBUFFERED ? 0 : 1, park, wait};
+                char* result = check_attr_channel(attr);
+                if (result) {
+                    return result;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+char* test_direct_handoff() {
+    print_test_details(__func__, "Testing that messages go straight to blocked receivers and from blocked senders");
+    channel_t* channel = channel_create(1);
+    pthread_t pid;
+
+    /* A send with a receiver waiting skips the buffer, so nobody else can take the message */
+    receive_args rargs;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_direct_handoff: Receive isn't blocked as expected", rargs.out == GEN_ERROR);
+    mu_assert("test_direct_handoff: Non-blocking send failed", channel_non_blocking_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_direct_handoff: Message went through the buffer", buffer_current_size(channel->buffer) == 0);
+    void* data = NULL;
+    mu_assert("test_direct_handoff: Message was taken by another receiver", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    pthread_join(pid, NULL);
+    mu_assert("test_direct_handoff: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message1"));
+
+    /* A receive that frees a slot moves the blocked sender's message in, ahead of later senders */
+    mu_assert("test_direct_handoff: Send failed", channel_send(channel, "Message2") == SUCCESS);
+    send_args sargs;
+    init_object_for_send_api(&sargs, channel, "Message3", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &sargs);
+    usleep(10000);
+    mu_assert("test_direct_handoff: Send isn't blocked as expected", sargs.out == GEN_ERROR);
+    mu_assert("test_direct_handoff: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message2"));
+    mu_assert("test_direct_handoff: Blocked message wasn't moved in", buffer_current_size(channel->buffer) == 1);
+    mu_assert("test_direct_handoff: Later send overtook the blocked one", channel_non_blocking_send(channel, "Message4") == CHANNEL_FULL);
+    pthread_join(pid, NULL);
+    mu_assert("test_direct_handoff: Blocked send failed", sargs.out == SUCCESS);
+    mu_assert("test_direct_handoff: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message3"));
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_select_set() {
+    print_test_details(__func__, "Testing select sets that stay registered across waits");
+    size_t ROUNDS = 100;
+    channel_t* channels[] = {channel_create(1), channel_create(0), channel_create_mpmc(2), channel_create(0)};
+    select_t entries[] = {{channels[0], RECV, NULL}, {channels[1], RECV, NULL},
+                          {channels[2], RECV, NULL}, {channels[3], SEND, NULL}};
+    select_t* selected = NULL;
+
+    select_set_t* set = select_set_create();
+    mu_assert("test_select_set: Could not create set", set != NULL);
+    mu_assert("test_select_set: Wait on an empty set should fail", select_set_wait(set, &selected) == GEN_ERROR);
+    for (size_t i = 0; i < 3; i++) {
+        mu_assert("test_select_set: Add failed", select_set_add(set, &entries[i]) == SUCCESS);
+    }
+    mu_assert("test_select_set: Adding a case twice should fail", select_set_add(set, &entries[0]) == GEN_ERROR);
+
+    /* Each wait picks up the message of whichever channel a sender used */
+    pthread_t pid;
+    for (size_t round = 1; round <= ROUNDS; round++) {
+        size_t k = round % 3;
+        send_args sargs;
+        init_object_for_send_api(&sargs, channels[k], (char*)round, NULL);
+        pthread_create(&pid, NULL, (void *)helper_send, &sargs);
+        mu_assert("test_select_set: Wait failed", select_set_wait(set, &selected) == SUCCESS);
+        mu_assert("test_select_set: Wrong case selected", selected == &entries[k]);
+        mu_assert("test_select_set: Wrong message", (size_t)entries[k].data == round);
+        pthread_join(pid, NULL);
+        mu_assert("test_select_set: Send failed", sargs.out == SUCCESS);
+    }
+
+    /* A send case sends what its entry holds at the time of the wait */
+    mu_assert("test_select_set: Add failed", select_set_add(set, &entries[3]) == SUCCESS);
+    for (size_t round = 1; round <= 3; round++) {
+        entries[3].data = (void*)round;
+        receive_args rargs;
+        init_object_for_receive_api(&rargs, channels[3], NULL);
+        pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+        mu_assert("test_select_set: Wait failed", select_set_wait(set, &selected) == SUCCESS);
+        mu_assert("test_select_set: Wrong case selected", selected == &entries[3]);
+        pthread_join(pid, NULL);
+        mu_assert("test_select_set: Wrong message", rargs.out == SUCCESS && (size_t)rargs.data == round);
+    }
+
+    /* A removed case leaves nothing behind on its channel */
+    mu_assert("test_select_set: Remove failed", select_set_remove(set, &entries[1]) == SUCCESS);
+    mu_assert("test_select_set: Removing a case twice should fail", select_set_remove(set, &entries[1]) == GEN_ERROR);
+    mu_assert("test_select_set: Removed case is still receiving", channel_non_blocking_send(channels[1], "Message") == CHANNEL_FULL);
+    entries[3].data = "Message";
+    receive_args rargs;
+    init_object_for_receive_api(&rargs, channels[3], NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    mu_assert("test_select_set: Wait failed", select_set_wait(set, &selected) == SUCCESS && selected == &entries[3]);
+    pthread_join(pid, NULL);
+
+    /* Closing a channel ends the wait on it */
+    mu_assert("test_select_set: Remove failed", select_set_remove(set, &entries[3]) == SUCCESS);
+    channel_close(channels[0]);
+    mu_assert("test_select_set: Wait should see the close", select_set_wait(set, &selected) == CLOSED_ERROR);
+    mu_assert("test_select_set: Wrong case selected", selected == &entries[0]);
+
+    select_set_destroy(set);
+    for (size_t i = 0; i < 4; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
+char* test_shared_subscribers() {
+    print_test_details(__func__, "Testing many selects subscribed to one shared channel");
+    const size_t THREADS = 16;
+    const size_t CASES = 10;                                 // More cases than a select keeps on its stack
+    channel_t* shared = channel_create_mpmc(1);              // Lock-free, so the selects subscribe to it
+    channel_t* own[THREADS];
+    select_t lists[THREADS][CASES];
+    select_args args[THREADS];
+    pthread_t pids[THREADS];
+
+    /* Every select hangs CASES-1 nodes on the shared channel; a send to a thread's own channel must still find it */
+    for (size_t i = 0; i < THREADS; i++) {
+        own[i] = channel_create(1);
+        lists[i][0] = (select_t) {own[i], RECV, NULL};
+        for (size_t k = 1; k < CASES; k++) {
+            lists[i][k] = (select_t) {shared, RECV, NULL};
+        }
+        init_object_for_select_api(&args[i], lists[i], CASES, NULL);
+        pthread_create(&pids[i], NULL, (void *)helper_select, &args[i]);
+    }
+    usleep(10000);
+    for (size_t i = 0; i < THREADS; i++) {
+        mu_assert("test_shared_subscribers: Send failed", channel_send(own[i], (void*)(i + 1)) == SUCCESS);
+    }
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(pids[i], NULL);
+        mu_assert("test_shared_subscribers: Wrong case selected", args[i].out == SUCCESS && args[i].index == 0);
+        mu_assert("test_shared_subscribers: Wrong message", (size_t)lists[i][0].data == i + 1);
+    }
+    mu_assert("test_shared_subscribers: Select left nodes behind", shared->not_empty.subscribers == NULL);
+
+    /* Closing the shared channel wakes every select at once */
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_create(&pids[i], NULL, (void *)helper_select, &args[i]);
+    }
+    usleep(10000);
+    channel_close(shared);
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(pids[i], NULL);
+        mu_assert("test_shared_subscribers: Select should see the close", args[i].out == CLOSED_ERROR && args[i].index > 0);
+    }
+    mu_assert("test_shared_subscribers: Select left nodes behind", shared->not_empty.subscribers == NULL);
+
+    /* A set that grows and shrinks keeps a blocked select on the same channel linked in */
+    channel_t* channel = channel_create_mpmc(1);
+    select_t entries[CASES];
+    select_t list[] = {{channel, RECV, NULL}};
+    select_args sargs;
+    init_object_for_select_api(&sargs, list, 1, NULL);
+    pthread_create(&pids[0], NULL, (void *)helper_select, &sargs);
+    usleep(10000);
+    select_set_t* set = select_set_create();
+    for (size_t k = 0; k < CASES; k++) {
+        entries[k] = (select_t) {channel, RECV, NULL};
+        mu_assert("test_shared_subscribers: Add failed", select_set_add(set, &entries[k]) == SUCCESS);
+    }
+    for (size_t k = 2; k < CASES - 1; k++) {
+        mu_assert("test_shared_subscribers: Remove failed", select_set_remove(set, &entries[k]) == SUCCESS);
+    }
+    mu_assert("test_shared_subscribers: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    pthread_join(pids[0], NULL);
+    mu_assert("test_shared_subscribers: Blocked select missed the send", sargs.out == SUCCESS && string_equal(list[0].data, "Message1"));
+
+    send_args send;
+    select_t* selected = NULL;
+    init_object_for_send_api(&send, channel, "Message2", NULL);
+    pthread_create(&pids[0], NULL, (void *)helper_send, &send);
+    mu_assert("test_shared_subscribers: Wait failed", select_set_wait(set, &selected) == SUCCESS);
+    mu_assert("test_shared_subscribers: Removed case selected", selected == &entries[0] || selected == &entries[1] || selected == &entries[CASES - 1]);
+    mu_assert("test_shared_subscribers: Wrong message", string_equal(selected->data, "Message2"));
+    pthread_join(pids[0], NULL);
+    select_set_destroy(set);
+    mu_assert("test_shared_subscribers: Set left nodes behind", channel->not_empty.subscribers == NULL);
+
+    channel_close(channel);
+    channel_destroy(channel);
+    channel_destroy(shared);
+    for (size_t i = 0; i < THREADS; i++) {
+        channel_close(own[i]);
+        channel_destroy(own[i]);
+    }
+    return NULL;
+}
+
+char* test_select_order() {
+    print_test_details(__func__, "Testing which ready case a select takes under each order");
+    size_t ROUNDS = 300;
+    size_t COUNT = 3;
+    channel_t* channels[] = {channel_create(1), channel_create(1), channel_create(1)};
+    select_t list[] = {{channels[0], RECV, NULL}, {channels[1], RECV, NULL}, {channels[2], RECV, NULL}};
+    size_t picked[] = {0, 0, 0};
+    size_t index;
+    for (size_t i = 0; i < COUNT; i++) {
+        mu_assert("test_select_order: Send failed", channel_send(channels[i], "Message") == SUCCESS);
+    }
+
+    /* Every case stays ready: in order always takes the first, random spreads over all of them */
+    for (size_t round = 0; round < ROUNDS; round++) {
+        mu_assert("test_select_order: Select failed", channel_select(list, COUNT, &index) == SUCCESS && index == 0);
+        mu_assert("test_select_order: Send failed", channel_send(channels[index], "Message") == SUCCESS);
+    }
+    for (size_t round = 0; round < ROUNDS; round++) {
+        mu_assert("test_select_order: Select failed", channel_select_ordered(list, COUNT, &index, SELECT_RANDOM) == SUCCESS);
+        picked[index]++;
+        mu_assert("test_select_order: Send failed", channel_send(channels[index], "Message") == SUCCESS);
+    }
+    for (size_t i = 0; i < COUNT; i++) {
+        mu_assert("test_select_order: A ready case starved", picked[i] > ROUNDS / 10);
+    }
+    mu_assert("test_select_order: Invalid order accepted", channel_select_ordered(list, COUNT, &index, (enum select_order)7) == GEN_ERROR);
+    mu_assert("test_select_order: Round robin needs a select set", channel_select_ordered(list, COUNT, &index, SELECT_ROUND_ROBIN) == GEN_ERROR);
+
+    /* A round robin set cycles through the ready cases */
+    select_set_t* set = select_set_create();
+    select_t* selected = NULL;
+    for (size_t i = 0; i < COUNT; i++) {
+        mu_assert("test_select_order: Add failed", select_set_add(set, &list[i]) == SUCCESS);
+    }
+    mu_assert("test_select_order: Set order failed", select_set_order(set, SELECT_ROUND_ROBIN) == SUCCESS);
+    for (size_t round = 0; round < ROUNDS; round++) {
+        mu_assert("test_select_order: Wait failed", select_set_wait(set, &selected) == SUCCESS);
+        mu_assert("test_select_order: Round robin skipped a case", selected == &list[round % COUNT]);
+        mu_assert("test_select_order: Send failed", channel_send(selected->channel, "Message") == SUCCESS);
+    }
+    mu_assert("test_select_order: Remove failed", select_set_remove(set, &list[1]) == SUCCESS);
+    mu_assert("test_select_order: Wait failed", select_set_wait(set, &selected) == SUCCESS && selected == &list[0]);
+    select_set_destroy(set);
+
+    for (size_t i = 0; i < COUNT; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
+typedef struct {
+    select_t list[2];
+    size_t count;
+    size_t sum;
+} commit_args;
+
+void* helper_select_sum(commit_args* myargs) {
+    size_t index;
+    while (channel_select(myargs->list, 2, &index) == SUCCESS) {
+        myargs->count++;
+        myargs->sum += (size_t)myargs->list[index].data;
+    }
+    return NULL;
+}
+
+char* test_select_commit() {
+    print_test_details(__func__, "Testing that a partner completes exactly the select case it takes");
+    channel_t* channels[] = {channel_create(1), channel_create(1)};
+    select_t list[] = {{channels[0], RECV, NULL}, {channels[1], RECV, NULL}};
+    select_args args;
+    pthread_t pid;
+
+    /* A send to an empty buffered channel hands the message straight to the blocked select */
+    init_object_for_select_api(&args, list, 2, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_commit: Select isn't blocked as expected", args.out == GEN_ERROR);
+    mu_assert("test_select_commit: Send failed", channel_send(channels[1], "Message1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_commit: Wrong case selected", args.out == SUCCESS && args.index == 1);
+    mu_assert("test_select_commit: Wrong message", string_equal(list[1].data, "Message1"));
+    mu_assert("test_select_commit: Message went through the buffer", buffer_current_size(channels[1]->buffer) == 0);
+    mu_assert("test_select_commit: Select left a waiter queued", channels[0]->recvq.head == NULL && channels[1]->recvq.head == NULL);
+
+    /* A receive from a full channel moves the blocked select's message into the freed slot */
+    select_t sends[] = {{channels[0], SEND, "Message3"}, {channels[0], SEND, "Message4"}};
+    mu_assert("test_select_commit: Send failed", channel_send(channels[0], "Message2") == SUCCESS);
+    init_object_for_select_api(&args, sends, 2, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_select_commit: Select isn't blocked as expected", args.out == GEN_ERROR);
+    void* data = NULL;
+    mu_assert("test_select_commit: Receive failed", channel_receive(channels[0], &data) == SUCCESS && string_equal(data, "Message2"));
+    pthread_join(pid, NULL);
+    mu_assert("test_select_commit: Select failed", args.out == SUCCESS && args.index == 0);
+    mu_assert("test_select_commit: Only one case may send", buffer_current_size(channels[0]->buffer) == 1);
+    mu_assert("test_select_commit: Receive failed", channel_receive(channels[0], &data) == SUCCESS && string_equal(data, "Message3"));
+    mu_assert("test_select_commit: Select left a waiter queued", channels[0]->sendq.head == NULL);
+
+    /* Selects competing for the same messages take each one exactly once */
+    const size_t SELECTS = 4;
+    const size_t MESSAGES = 2000;
+    commit_args workers[SELECTS];
+    pthread_t pids[SELECTS];
+    for (size_t i = 0; i < SELECTS; i++) {
+        workers[i] = (commit_args) {{{channels[0], RECV, NULL}, {channels[1], RECV, NULL}}, 0, 0};
+        pthread_create(&pids[i], NULL, (void *)helper_select_sum, &workers[i]);
+    }
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_select_commit: Send failed", channel_send(channels[i % 2], (void*)i) == SUCCESS);
+    }
+    for (size_t i = 0; i < 2; i++) {                        // Wait for the selects to drain both channels
+        pthread_mutex_lock(&channels[i]->mutex);
+        while (buffer_current_size(channels[i]->buffer) > 0) {
+            pthread_mutex_unlock(&channels[i]->mutex);
+            usleep(1000);
+            pthread_mutex_lock(&channels[i]->mutex);
+        }
+        pthread_mutex_unlock(&channels[i]->mutex);
+    }
+    channel_close(channels[0]);
+    size_t count = 0, sum = 0;
+    for (size_t i = 0; i < SELECTS; i++) {
+        pthread_join(pids[i], NULL);
+        count += workers[i].count;
+        sum += workers[i].sum;
+    }
+    mu_assert("test_select_commit: Messages were lost or duplicated", count == MESSAGES && sum == MESSAGES * (MESSAGES + 1) / 2);
+
+    channel_close(channels[1]);
+    for (size_t i = 0; i < 2; i++) {
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
+char* test_select_direction() {
+    print_test_details(__func__, "Testing that selects only subscribe to the side of a channel they wait for");
+    channel_t* channel = channel_create_mpmc(1);
+    select_t recv_list[] = {{channel, RECV, NULL}};
+    select_t send_list[] = {{channel, SEND, "Message2"}};
+    select_args args;
+    pthread_t pid;
+    bool only_data, only_space;
+
+    /* A blocked RECV case waits for data, so receives (which free space) never have to notify it */
+    init_object_for_select_api(&args, recv_list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    pthread_mutex_lock(&channel->mutex);
+    only_data = channel->not_empty.subscribers != NULL && channel->not_full.subscribers == NULL &&
+                atomic_load(&channel->not_empty.waiters) == 1 && atomic_load(&channel->not_full.waiters) == 0;
+    pthread_mutex_unlock(&channel->mutex);
+    mu_assert("test_select_direction: RECV case subscribed to the wrong side", only_data);
+    mu_assert("test_select_direction: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_select_direction: Select failed", args.out == SUCCESS && string_equal(recv_list[0].data, "Message1"));
+
+    /* A blocked SEND case waits for space, so sends never have to notify it */
+    mu_assert("test_select_direction: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    init_object_for_select_api(&args, send_list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    pthread_mutex_lock(&channel->mutex);
+    only_space = channel->not_full.subscribers != NULL && channel->not_empty.subscribers == NULL &&
+                 atomic_load(&channel->not_full.waiters) == 1 && atomic_load(&channel->not_empty.waiters) == 0;
+    pthread_mutex_unlock(&channel->mutex);
+    mu_assert("test_select_direction: SEND case subscribed to the wrong side", only_space);
+    void* data = NULL;
+    mu_assert("test_select_direction: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message1"));
+    pthread_join(pid, NULL);
+    mu_assert("test_select_direction: Select failed", args.out == SUCCESS);
+    mu_assert("test_select_direction: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message2"));
+    mu_assert("test_select_direction: Select left nodes behind", channel->not_full.subscribers == NULL && atomic_load(&channel->not_full.waiters) == 0);
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+void* helper_close(channel_t* channel) {
+    usleep(5000);
+    channel_close(channel);
+    return NULL;
+}
+
+char* test_deadline() {
+    print_test_details(__func__, "Testing sends, receives and selects that give up at a deadline");
+    uint64_t WAIT = 5000000;                                    // 5ms
+    channel_attr_t attrs[] = {{CHANNEL_LOCKED, 1, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_LOCKED, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_SPIN},
+                              {CHANNEL_SPSC, 1, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_MPMC, 1, CHANNEL_PARK_FUTEX, CHANNEL_WAIT_BLOCK},
+                              {CHANNEL_UNBUFFERED, 0, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK}};
+    struct timespec deadline;
+    void* data = NULL;
+    size_t index = 0;
+
+    for (size_t k = 0; k < sizeof(attrs) / sizeof(attrs[0]); k++) {
+        channel_t* channel = channel_create_with_attr(&attrs[k]);
+        mu_assert("test_deadline: Could not create channel", channel != NULL);
+
+        /* Nothing to receive: the receive gives up at the deadline, not much later, and leaves nothing queued */
+        uint64_t t = getTime();
+        convertTimeToTimespec(t + WAIT, &deadline);
+        mu_assert("test_deadline: Receive should time out", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+        t = getTime() - t;
+        mu_assert("test_deadline: Receive returned before the deadline", t >= WAIT);
+        mu_assert("test_deadline: Receive returned long after the deadline", t < 40 * WAIT);
+        mu_assert("test_deadline: Receive left a waiter behind", channel->recvq.head == NULL);
+
+        /* No room to send */
+        if (attrs[k].kind != CHANNEL_UNBUFFERED) {
+            mu_assert("test_deadline: Send failed", channel_send(channel, "Message1") == SUCCESS);
+        }
+        t = getTime();
+        convertTimeToTimespec(t + WAIT, &deadline);
+        mu_assert("test_deadline: Send should time out", channel_send_until(channel, "Message2", &deadline) == TIMEOUT);
+        t = getTime() - t;
+        mu_assert("test_deadline: Send returned before the deadline", t >= WAIT);
+        mu_assert("test_deadline: Send left a waiter behind", channel->sendq.head == NULL);
+
+        /* A deadline that already passed still takes a message that is ready */
+        convertTimeToTimespec(getTime() - WAIT, &deadline);
+        if (attrs[k].kind != CHANNEL_UNBUFFERED) {
+            mu_assert("test_deadline: Ready receive failed", channel_receive_until(channel, &data, &deadline) == SUCCESS && string_equal(data, "Message1"));
+        }
+        mu_assert("test_deadline: Receive should time out", channel_receive_until(channel, &data, &deadline) == TIMEOUT);
+
+        /* A partner that shows up before the deadline wins */
+        send_args sargs;
+        init_object_for_send_api(&sargs, channel, "Message3", NULL);
+        pthread_t pid;
+        pthread_create(&pid, NULL, (void *)helper_send, &sargs);
+        convertTimeToTimespec(getTime() + 500 * WAIT, &deadline);
+        mu_assert("test_deadline: Receive failed", channel_receive_until(channel, &data, &deadline) == SUCCESS && string_equal(data, "Message3"));
+        pthread_join(pid, NULL);
+        mu_assert("test_deadline: Send failed", sargs.out == SUCCESS);
+
+        /* Select over the channel and an unbuffered one: gives up with selected_index == count and unqueues every case */
+        channel_t* other = channel_create(0);
+        select_t list[] = {{channel, RECV, NULL}, {other, SEND, "Message4"}};
+        t = getTime();
+        convertTimeToTimespec(t + WAIT, &deadline);
+        mu_assert("test_deadline: Select should time out", channel_select_until(list, 2, &index, &deadline) == TIMEOUT);
+        t = getTime() - t;
+        mu_assert("test_deadline: Select returned before the deadline", t >= WAIT);
+        mu_assert("test_deadline: Select should report no case", index == 2);
+        mu_assert("test_deadline: Select left a waiter behind", channel->recvq.head == NULL && other->sendq.head == NULL);
+        mu_assert("test_deadline: Select left a subscription behind", channel->not_empty.subscribers == NULL);
+
+        receive_args rargs;
+        init_object_for_receive_api(&rargs, other, NULL);
+        pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+        convertTimeToTimespec(getTime() + 500 * WAIT, &deadline);
+        mu_assert("test_deadline: Select failed", channel_select_until(list, 2, &index, &deadline) == SUCCESS && index == 1);
+        pthread_join(pid, NULL);
+        mu_assert("test_deadline: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message4"));
+
+        channel_close(other);
+        channel_destroy(other);
+
+        /* Closing the channel wakes a receive that waits with a deadline */
+        pthread_create(&pid, NULL, (void *)helper_close, channel);
+        convertTimeToTimespec(getTime() + 500 * WAIT, &deadline);
+        mu_assert("test_deadline: Close should wake a receive with a deadline", channel_receive_until(channel, &data, &deadline) == CLOSED_ERROR);
+        pthread_join(pid, NULL);
+        mu_assert("test_deadline: Closed channel should report the close, not a timeout", channel_receive_until(channel, &data, &deadline) == CLOSED_ERROR);
+        channel_destroy(channel);
+    }
+    return NULL;
+}
+
+char* test_unbounded() {
+    print_test_details(__func__, "Testing unbounded channels that grow and shrink by segments");
+    size_t MESSAGES = 10 * CHANNEL_SEGMENT_SIZE + 3;
+    channel_t* channel = channel_create_unbounded();
+    mu_assert("test_unbounded: Could not create channel", channel != NULL);
+    mu_assert("test_unbounded: Zero-sized segments should be rejected",
+              channel_create_with_attr(&(channel_attr_t) {CHANNEL_UNBOUNDED, 0, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK}) == NULL);
+
+    /* Sends never block; the buffer grows one segment at a time and keeps FIFO order across segments */
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_unbounded: Send should never be full", channel_non_blocking_send(channel, (void*)i) == SUCCESS);
+    }
+    mu_assert("test_unbounded: Wrong size", buffer_current_size(channel->buffer) == MESSAGES);
+    mu_assert("test_unbounded: Peek failed", (size_t)peek_buffer(channel->buffer, CHANNEL_SEGMENT_SIZE) == CHANNEL_SEGMENT_SIZE + 1);
+    select_t list[] = {{channel, SEND, (void*)(MESSAGES + 1)}};
+    size_t index = 1;
+    mu_assert("test_unbounded: Select send should never block", channel_select(list, 1, &index) == SUCCESS && index == 0);
+    void* batch[CHANNEL_SEGMENT_SIZE + 7];
+    size_t received = 0;
+    mu_assert("test_unbounded: Batch receive failed",
+              channel_receive_batch(channel, batch, CHANNEL_SEGMENT_SIZE + 7, &received) == SUCCESS && received == CHANNEL_SEGMENT_SIZE + 7);
+    for (size_t i = 0; i < received; i++) {
+        mu_assert("test_unbounded: Wrong order", (size_t)batch[i] == i + 1);
+    }
+    void* data = NULL;
+    for (size_t i = received + 1; i <= MESSAGES + 1; i++) {
+        mu_assert("test_unbounded: Receive failed", channel_receive(channel, &data) == SUCCESS && (size_t)data == i);
+    }
+
+    /* Once drained, only the segment being written and a few spares are left */
+    size_t segments = 1;
+    for (buffer_segment_t* segment = channel->buffer->head; segment != channel->buffer->tail; segment = segment->next) {
+        segments++;
+    }
+    mu_assert("test_unbounded: Drained segments were not released", segments == 1 && channel->buffer->spare_count == BUFFER_SPARE_SEGMENTS);
+    mu_assert("test_unbounded: Receive should be empty", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+
+    /* Batches larger than a segment, and a receiver blocked on an empty channel */
+    size_t sent = 0;
+    for (size_t i = 0; i < sizeof(batch) / sizeof(batch[0]); i++) {
+        batch[i] = (void*)(i + 1);
+    }
+    mu_assert("test_unbounded: Batch send failed",
+              channel_send_batch(channel, batch, CHANNEL_SEGMENT_SIZE + 7, &sent) == SUCCESS && sent == CHANNEL_SEGMENT_SIZE + 7);
+    for (size_t i = 1; i <= sent; i++) {
+        mu_assert("test_unbounded: Receive failed", channel_receive(channel, &data) == SUCCESS && (size_t)data == i);
+    }
+    receive_args rargs;
+    pthread_t pid;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_unbounded: Receive isn't blocked as expected", rargs.out == GEN_ERROR);
+    mu_assert("test_unbounded: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_unbounded: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message1"));
+
+    /* A close with messages still queued frees every segment on destroy */
+    mu_assert("test_unbounded: Send failed", channel_send(channel, "Message2") == SUCCESS);
+    mu_assert("test_unbounded: Close failed", channel_close(channel) == SUCCESS);
+    mu_assert("test_unbounded: Send should see the close", channel_send(channel, "Message3") == CLOSED_ERROR);
+    mu_assert("test_unbounded: Destroy failed", channel_destroy(channel) == SUCCESS);
+
+    /* One-slot segments with a concurrent sender, on every wait policy */
+    for (enum channel_wait wait = CHANNEL_WAIT_BLOCK; wait <= CHANNEL_WAIT_POLL; wait++) {
+        char* result = check_attr_channel((channel_attr_t) {CHANNEL_UNBOUNDED, 1, CHANNEL_PARK_FUTEX, wait});
+        if (result) {
+            return result;
+        }
+    }
+    return NULL;
+}
+
+char* test_priority() {
+    print_test_details(__func__, "Testing priority channels that deliver the highest priority first");
+    size_t MESSAGES = 1000;
+    mu_assert("test_priority: Zero size should be rejected", channel_create_priority(0) == NULL);
+    channel_t* channel = channel_create_priority(MESSAGES);
+    mu_assert("test_priority: Could not create channel", channel != NULL);
+
+    /* Higher priorities overtake, and equal priorities keep their order */
+    int priorities[] = {1, 5, 1, 3, 5, 0};
+    const char* messages[] = {"1a", "5a", "1b", "3", "5b", "0a"};
+    for (size_t i = 0; i < 6; i++) {
+        mu_assert("test_priority: Send failed", channel_non_blocking_send_priority(channel, (void*)messages[i], priorities[i]) == SUCCESS);
+    }
+    mu_assert("test_priority: Send failed", channel_send(channel, "0b") == SUCCESS);
+    const char* expected[] = {"5a", "5b", "3", "1a", "1b", "0a", "0b"};
+    void* data = NULL;
+    for (size_t i = 0; i < 7; i++) {
+        mu_assert("test_priority: Wrong order", channel_receive(channel, &data) == SUCCESS && string_equal(data, expected[i]));
+    }
+
+    /* Many random priorities come out sorted, each priority in sending order */
+    for (size_t i = 0; i < MESSAGES; i++) {
+        int priority = rand() % 16;
+        mu_assert("test_priority: Send failed", channel_send_priority(channel, (void*)((size_t)priority * MESSAGES + i), priority) == SUCCESS);
+    }
+    mu_assert("test_priority: Send should see a full channel", channel_non_blocking_send_priority(channel, "Message", 99) == CHANNEL_FULL);
+    size_t last = SIZE_MAX;
+    for (size_t i = 0; i < MESSAGES; i++) {
+        mu_assert("test_priority: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+        size_t key = (size_t)data;
+        mu_assert("test_priority: Wrong order", last == SIZE_MAX || key / MESSAGES < last / MESSAGES ||
+                                                (key / MESSAGES == last / MESSAGES && key > last));
+        last = key;
+    }
+    mu_assert("test_priority: Receive should be empty", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    /* Select sends with the case's priority, also when it has to block on a full channel */
+    channel = channel_create_priority(2);
+    mu_assert("test_priority: Send failed", channel_send_priority(channel, "Low1", 1) == SUCCESS);
+    mu_assert("test_priority: Send failed", channel_send_priority(channel, "Low2", 1) == SUCCESS);
+    select_t send_list[] = {{channel, SEND, "High", 9}};
+    select_args args;
+    pthread_t pid;
+    init_object_for_select_api(&args, send_list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &args);
+    usleep(10000);
+    mu_assert("test_priority: Select isn't blocked as expected", args.out == GEN_ERROR);
+    mu_assert("test_priority: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Low1"));
+    pthread_join(pid, NULL);
+    mu_assert("test_priority: Select failed", args.out == SUCCESS);
+    select_t recv_list[] = {{channel, RECV, NULL}};
+    size_t index = 1;
+    mu_assert("test_priority: Select receive failed", channel_select(recv_list, 1, &index) == SUCCESS && index == 0);
+    mu_assert("test_priority: Blocked sender lost its priority", string_equal(recv_list[0].data, "High"));
+    mu_assert("test_priority: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Low2"));
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+typedef struct {
+    broadcast_cursor_t* cursor;
+    size_t count;
+    enum channel_status out;
+    bool in_order;                                          // Every message received was 1, 2, ... count in turn
+} broadcast_args;
+
+void* helper_broadcast_receive(broadcast_args* myargs) {
+    enum channel_status out = SUCCESS;
+    myargs->in_order = true;
+    for (size_t i = 1; i <= myargs->count && out == SUCCESS; i++) {
+        void* data = NULL;
+        out = broadcast_receive(myargs->cursor, &data);
+        if (out == SUCCESS && (size_t)data != i) {
+            myargs->in_order = false;
+        }
+    }
+    myargs->out = out;
+    return NULL;
+}
+
+typedef struct {
+    broadcast_t* broadcast;
+    enum channel_status out;
+} broadcast_send_args;
+
+void* helper_broadcast_send(broadcast_send_args* myargs) {
+    myargs->out = broadcast_send(myargs->broadcast, "Blocked");
+    return NULL;
+}
+
+char* test_broadcast() {
+    print_test_details(__func__, "Testing broadcasts that deliver every message to every subscriber");
+    size_t MESSAGES = 10000, READERS = 4;
+    mu_assert("test_broadcast: Zero size should be rejected", broadcast_create(0) == NULL);
+    broadcast_t* broadcast = broadcast_create(2);
+    mu_assert("test_broadcast: Could not create broadcast", broadcast != NULL);
+    void* data = NULL;
+
+    /* Nobody subscribed: messages are dropped, and the sender never waits */
+    for (size_t i = 0; i < 5; i++) {
+        mu_assert("test_broadcast: Send without subscribers failed", broadcast_non_blocking_send(broadcast, "Dropped") == SUCCESS);
+    }
+
+    /* The slowest cursor holds the sender back, and every cursor sees every message */
+    broadcast_cursor_t* fast = broadcast_subscribe(broadcast);
+    broadcast_cursor_t* slow = broadcast_subscribe(broadcast);
+    mu_assert("test_broadcast: Subscribe failed", fast != NULL && slow != NULL);
+    mu_assert("test_broadcast: Nothing sent yet", broadcast_non_blocking_receive(fast, &data) == CHANNEL_EMPTY);
+    mu_assert("test_broadcast: Send failed", broadcast_send(broadcast, "Message1") == SUCCESS);
+    mu_assert("test_broadcast: Send failed", broadcast_send(broadcast, "Message2") == SUCCESS);
+    mu_assert("test_broadcast: Send should see a full ring", broadcast_non_blocking_send(broadcast, "Message3") == CHANNEL_FULL);
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && string_equal(data, "Message1"));
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && string_equal(data, "Message2"));
+    mu_assert("test_broadcast: Fast cursor should not free the slow one's slots", broadcast_non_blocking_send(broadcast, "Message3") == CHANNEL_FULL);
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(slow, &data) == SUCCESS && string_equal(data, "Message1"));
+    mu_assert("test_broadcast: Send failed", broadcast_non_blocking_send(broadcast, "Message3") == SUCCESS);
+
+    /* Unsubscribing the slowest cursor releases the sender */
+    mu_assert("test_broadcast: Send should see a full ring", broadcast_non_blocking_send(broadcast, "Message4") == CHANNEL_FULL);
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && string_equal(data, "Message3"));
+    broadcast_unsubscribe(slow);
+    mu_assert("test_broadcast: Send failed", broadcast_non_blocking_send(broadcast, "Message4") == SUCCESS);
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && string_equal(data, "Message4"));
+
+    /* A late subscriber starts with the next message */
+    broadcast_cursor_t* late = broadcast_subscribe(broadcast);
+    mu_assert("test_broadcast: Send failed", broadcast_send(broadcast, "Message5") == SUCCESS);
+    mu_assert("test_broadcast: Late cursor saw an old message", broadcast_receive(late, &data) == SUCCESS && string_equal(data, "Message5"));
+    mu_assert("test_broadcast: Receive failed", broadcast_receive(fast, &data) == SUCCESS && string_equal(data, "Message5"));
+    broadcast_unsubscribe(late);
+
+    /* Close releases a blocked receiver and a blocked sender */
+    broadcast_args args = {fast, 1, GEN_ERROR, true};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_broadcast_receive, &args);
+    usleep(10000);
+    mu_assert("test_broadcast: Receive isn't blocked as expected", args.out == GEN_ERROR);
+    mu_assert("test_broadcast: Destroy should fail on an open broadcast", broadcast_destroy(broadcast) == DESTROY_ERROR);
+    mu_assert("test_broadcast: Close failed", broadcast_close(broadcast) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast: Receive should see the close", args.out == CLOSED_ERROR);
+    mu_assert("test_broadcast: Second close should fail", broadcast_close(broadcast) == CLOSED_ERROR);
+    mu_assert("test_broadcast: Send should see the close", broadcast_send(broadcast, "Message6") == CLOSED_ERROR);
+    mu_assert("test_broadcast: Subscribe should see the close", broadcast_subscribe(broadcast) == NULL);
+    mu_assert("test_broadcast: Destroy failed", broadcast_destroy(broadcast) == SUCCESS);   // Frees fast too
+
+    /* Concurrent readers each get the whole stream in order through a small ring */
+    broadcast = broadcast_create(8);
+    pthread_t readers[READERS];
+    broadcast_args reader_args[READERS];
+    for (size_t i = 0; i < READERS; i++) {
+        reader_args[i] = (broadcast_args) {broadcast_subscribe(broadcast), MESSAGES, GEN_ERROR, true};
+        pthread_create(&readers[i], NULL, (void *)helper_broadcast_receive, &reader_args[i]);
+    }
+    for (size_t i = 1; i <= MESSAGES; i++) {
+        mu_assert("test_broadcast: Send failed", broadcast_send(broadcast, (void*)i) == SUCCESS);
+    }
+    for (size_t i = 0; i < READERS; i++) {
+        pthread_join(readers[i], NULL);
+        mu_assert("test_broadcast: Receive failed", reader_args[i].out == SUCCESS);
+        mu_assert("test_broadcast: Reader missed or reordered a message", reader_args[i].in_order);
+    }
+
+    /* And a sender blocked on the slowest reader is released by close */
+    for (size_t i = 0; i < 8; i++) {
+        mu_assert("test_broadcast: Send failed", broadcast_send(broadcast, "Message") == SUCCESS);
+    }
+    broadcast_send_args sargs = {broadcast, GEN_ERROR};
+    pthread_create(&pid, NULL, (void *)helper_broadcast_send, &sargs);
+    usleep(10000);
+    mu_assert("test_broadcast: Send isn't blocked as expected", sargs.out == GEN_ERROR);
+    broadcast_close(broadcast);
+    pthread_join(pid, NULL);
+    mu_assert("test_broadcast: Send should see the close", sargs.out == CLOSED_ERROR);
+    broadcast_destroy(broadcast);
+    return NULL;
+}
+
+typedef struct {
+    size_t id;
+    double weight;
+    char tag[8];
+} typed_value;                                              // 24 bytes, sent by value through a typed channel
+
+typedef struct {
+    channel_t* channel;
+    size_t first;                                           // Producers send ids first, first + 1, ... first + count - 1
+    size_t count;
+    size_t sum;                                             // Consumers add up the ids they received
+    enum channel_status out;
+} typed_args;
+
+void* helper_typed_send(typed_args* myargs) {
+    enum channel_status out = SUCCESS;
+    for (size_t i = 0; i < myargs->count && out == SUCCESS; i++) {
+        typed_value value = {myargs->first + i, (double)(myargs->first + i) / 2, "value"};
+        out = channel_send_value(myargs->channel, &value);
+    }
+    myargs->out = out;
+    return NULL;
+}
+
+void* helper_typed_receive(typed_args* myargs) {
+    enum channel_status out = SUCCESS;
+    myargs->sum = 0;
+    for (size_t i = 0; i < myargs->count && out == SUCCESS; i++) {
+        typed_value value;
+        out = channel_receive_value(myargs->channel, &value);
+        if (out == SUCCESS && (value.weight != (double)value.id / 2 || !string_equal(value.tag, "value"))) {
+            out = GEN_ERROR;                                // Torn or mixed-up value
+        }
+        myargs->sum += value.id;
+    }
+    myargs->out = out;
+    return NULL;
+}
+
+char* test_typed() {
+    print_test_details(__func__, "Testing typed channels that copy fixed-size values in and out");
+    size_t THREADS = 4;
+    size_t MESSAGES = 1000;
+    mu_assert("test_typed: Zero element size should be rejected", channel_create_typed(0, 4) == NULL);
+    mu_assert("test_typed: Zero capacity should be rejected", channel_create_typed(sizeof(typed_value), 0) == NULL);
+    channel_attr_t bad = {CHANNEL_TYPED, 4, CHANNEL_PARK_COND, CHANNEL_WAIT_BLOCK, 0};
+    mu_assert("test_typed: Attributes without an element size should be rejected", channel_create_with_attr(&bad) == NULL);
+    channel_t* channel = channel_create_typed(sizeof(typed_value), 3);
+    mu_assert("test_typed: Could not create channel", channel != NULL);
+
+    /* Values are copied: the sender's variable can be reused right away, and they come out in order */
+    typed_value value = {1, 0.5, "value"};
+    mu_assert("test_typed: Send failed", channel_send_value(channel, &value) == SUCCESS);
+    value = (typed_value) {2, 1.0, "value"};
+    mu_assert("test_typed: Send failed", channel_non_blocking_send_value(channel, &value) == SUCCESS);
+    value = (typed_value) {3, 1.5, "value"};
+    mu_assert("test_typed: Send failed", channel_send(channel, &value) == SUCCESS);
+    mu_assert("test_typed: Send should see a full channel", channel_non_blocking_send_value(channel, &value) == CHANNEL_FULL);
+    for (size_t id = 1; id <= 3; id++) {
+        typed_value out;
+        memset(&out, 0, sizeof(out));
+        mu_assert("test_typed: Receive failed", channel_receive_value(channel, &out) == SUCCESS);
+        mu_assert("test_typed: Wrong value", out.id == id && out.weight == (double)id / 2 && string_equal(out.tag, "value"));
+    }
+    mu_assert("test_typed: Receive should be empty", channel_non_blocking_receive_value(channel, &value) == CHANNEL_EMPTY);
+    channel_t* pointers = channel_create_mpmc(1);
+    mu_assert("test_typed: Pointer channels should be rejected", channel_send_value(pointers, &value) == GEN_ERROR);
+    channel_close(pointers);
+    channel_destroy(pointers);
+
+    /* Select sends the value data points to, and receives into the storage data points to */
+    typed_value sent = {7, 3.5, "value"}, received = {0, 0, ""};
+    select_t list[] = {{channel, SEND, &sent}};
+    size_t index = 1;
+    mu_assert("test_typed: Select send failed", channel_select(list, 1, &index) == SUCCESS && index == 0);
+    list[0] = (select_t) {channel, RECV, &received};
+    mu_assert("test_typed: Select receive failed", channel_select(list, 1, &index) == SUCCESS && index == 0);
+    mu_assert("test_typed: Wrong value", received.id == 7 && list[0].data == &received);
+
+    /* Blocked receivers are woken by sends, and every value arrives exactly once */
+    pthread_t producers[THREADS], consumers[THREADS];
+    typed_args sends[THREADS], receives[THREADS];
+    for (size_t i = 0; i < THREADS; i++) {
+        receives[i] = (typed_args) {channel, 0, MESSAGES, 0, GEN_ERROR};
+        pthread_create(&consumers[i], NULL, (void *)helper_typed_receive, &receives[i]);
+    }
+    for (size_t i = 0; i < THREADS; i++) {
+        sends[i] = (typed_args) {channel, i * MESSAGES, MESSAGES, 0, GEN_ERROR};
+        pthread_create(&producers[i], NULL, (void *)helper_typed_send, &sends[i]);
+    }
+    size_t sum = 0;
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+        mu_assert("test_typed: Send failed", sends[i].out == SUCCESS);
+        mu_assert("test_typed: Receive failed", receives[i].out == SUCCESS);
+        sum += receives[i].sum;
+    }
+    size_t total = THREADS * MESSAGES;
+    mu_assert("test_typed: Values were lost or duplicated", sum == total * (total - 1) / 2);
+
+    /* Close wakes a blocked receiver */
+    typed_args rargs = {channel, 0, 1, 0, GEN_ERROR};
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_typed_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_typed: Receive isn't blocked as expected", rargs.out == GEN_ERROR);
+    mu_assert("test_typed: Close failed", channel_close(channel) == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_typed: Receive should see the channel closed", rargs.out == CLOSED_ERROR);
+    mu_assert("test_typed: Send should see the channel closed", channel_send_value(channel, &value) == CLOSED_ERROR);
+    channel_destroy(channel);
+    return NULL;
+}
+
+char* test_pow2_ring() {
+    print_test_details(__func__, "Testing buffered channels whose ring is rounded up to a power of two");
+    size_t ROUNDS = 1000;
+    size_t capacities[] = {1, 3, 4, 5};
+    for (size_t k = 0; k < sizeof(capacities) / sizeof(capacities[0]); k++) {
+        size_t capacity = capacities[k];
+        channel_t* channel = channel_create(capacity);
+        mu_assert("test_pow2_ring: Ring is not a power of two", (channel->buffer->mask & (channel->buffer->mask + 1)) == 0);
+        mu_assert("test_pow2_ring: Ring is too small", channel->buffer->mask + 1 >= capacity);
+
+        /* The channel still holds exactly capacity messages, however many times the counters wrap the ring */
+        size_t sent = 0, received = 0;
+        void* data = NULL;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            size_t burst = round % capacity + 1;
+            for (size_t i = 0; i < burst; i++) {
+                mu_assert("test_pow2_ring: Send failed", channel_non_blocking_send(channel, (void*)++sent) == SUCCESS);
+            }
+            if (burst == capacity) {
+                mu_assert("test_pow2_ring: Send should see a full channel", channel_non_blocking_send(channel, "Message") == CHANNEL_FULL);
+            }
+            mu_assert("test_pow2_ring: Wrong size", buffer_current_size(channel->buffer) == burst);
+            for (size_t i = 0; i < burst; i++) {
+                mu_assert("test_pow2_ring: Wrong order", channel_non_blocking_receive(channel, &data) == SUCCESS && (size_t)data == ++received);
+            }
+            mu_assert("test_pow2_ring: Receive should be empty", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+        }
+
+        /* Batches split around the end of the ring */
+        void* items[8];
+        void* out[8];
+        for (size_t round = 0; round < ROUNDS; round++) {
+            size_t count = round % capacity + 1;
+            for (size_t i = 0; i < count; i++) {
+                items[i] = (void*)++sent;
+            }
+            size_t done = 0;
+            mu_assert("test_pow2_ring: Batch send failed", channel_send_batch(channel, items, count, &done) == SUCCESS && done == count);
+            mu_assert("test_pow2_ring: Batch receive failed", channel_receive_batch(channel, out, 8, &done) == SUCCESS && done == count);
+            for (size_t i = 0; i < count; i++) {
+                mu_assert("test_pow2_ring: Wrong batch order", (size_t)out[i] == ++received);
+            }
+        }
+        channel_close(channel);
+        channel_destroy(channel);
+    }
+    return NULL;
+}
+
+char* test_channel_array() {
+    print_test_details(__func__, "Testing channels created and destroyed together in one arena");
+    size_t COUNT = 1000;
+    mu_assert("test_channel_array: Zero count should be rejected", channel_create_array(0, 1) == NULL);
+
+    /* Buffered channels each get their own ring, right behind the channel */
+    channel_t** channels = channel_create_array(COUNT, 3);
+    mu_assert("test_channel_array: Could not create channels", channels != NULL);
+    void* data = NULL;
+    for (size_t i = 0; i < COUNT; i++) {
+        mu_assert("test_channel_array: Wrong capacity", buffer_capacity(channels[i]->buffer) == 3);
+        for (size_t k = 0; k < 3; k++) {
+            mu_assert("test_channel_array: Send failed", channel_non_blocking_send(channels[i], (void*)(i * 3 + k)) == SUCCESS);
+        }
+        mu_assert("test_channel_array: Send should see a full channel", channel_non_blocking_send(channels[i], "Message") == CHANNEL_FULL);
+    }
+    for (size_t i = 0; i < COUNT; i++) {
+        for (size_t k = 0; k < 3; k++) {
+            mu_assert("test_channel_array: Channels share storage", channel_receive(channels[i], &data) == SUCCESS && (size_t)data == i * 3 + k);
+        }
+    }
+
+    /* Blocking and select work as on any channel */
+    receive_args rargs;
+    pthread_t pid;
+    init_object_for_receive_api(&rargs, channels[COUNT - 1], NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_channel_array: Receive isn't blocked as expected", rargs.out == GEN_ERROR);
+    select_t list[] = {{channels[0], RECV, NULL}, {channels[COUNT - 1], SEND, "Message1"}};
+    size_t index = 2;
+    mu_assert("test_channel_array: Select failed", channel_select(list, 2, &index) == SUCCESS && index == 1);
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_array: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message1"));
+
+    /* Only the whole array can be destroyed, and only once every channel is closed */
+    mu_assert("test_channel_array: Close failed", channel_close(channels[0]) == SUCCESS);
+    mu_assert("test_channel_array: Single destroy should fail", channel_destroy(channels[0]) == GEN_ERROR);
+    mu_assert("test_channel_array: Destroy should fail on open channels", channel_destroy_array(channels, COUNT) == DESTROY_ERROR);
+    for (size_t i = 1; i < COUNT; i++) {
+        channel_close(channels[i]);
+    }
+    mu_assert("test_channel_array: Destroy failed", channel_destroy_array(channels, COUNT) == SUCCESS);
+
+    /* Unbuffered channels have no ring at all */
+    channels = channel_create_array(2, 0);
+    mu_assert("test_channel_array: Could not create channels", channels != NULL && channels[1]->buffer == NULL);
+    send_args sargs;
+    init_object_for_send_api(&sargs, channels[1], "Message2", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &sargs);
+    mu_assert("test_channel_array: Receive failed", channel_receive(channels[1], &data) == SUCCESS && string_equal(data, "Message2"));
+    pthread_join(pid, NULL);
+    mu_assert("test_channel_array: Send failed", sargs.out == SUCCESS);
+    channel_close(channels[0]);
+    channel_close(channels[1]);
+    mu_assert("test_channel_array: Destroy failed", channel_destroy_array(channels, 2) == SUCCESS);
+    return NULL;
+}
+
+typedef struct {
+    channel_t** channels;
+    size_t count;                                           // Channels to send on, one message each in turn
+    size_t rounds;
+} select_partner_args;
+
+void* helper_select_partner(select_partner_args* myargs) {
+    for (size_t round = 0; round < myargs->rounds; round++) {
+        channel_send(myargs->channels[round % myargs->count], (void*)(round + 1));
+    }
+    return NULL;
+}
+
+void* helper_pool_churn(void* arg) {
+    (void)arg;
+    list_t* list = list_create();
+    for (size_t i = 1; i <= POOL_CACHE_BLOCKS; i++) {
+        list_insert(list, (void*)i);
+    }
+    list_destroy(list);                                     // The nodes go to the shared lists when we exit
+    return NULL;
+}
+
+char* test_pool() {
+    print_test_details(__func__, "Testing that steady select and list loops allocate nothing from the heap");
+    size_t CASES = 12;                                      // More than fit on the stack of channel_select
+    size_t WARMUP = 50;
+    size_t ROUNDS = 500;
+
+    /* Freed blocks are handed out again, by size class */
+    void* block = pool_alloc(40);
+    mu_assert("test_pool: Alloc failed", block != NULL);
+    pool_free(block, 40);
+    mu_assert("test_pool: Block was not reused", pool_alloc(64) == block);
+    pool_free(block, 64);
+    block = pool_alloc(POOL_MAX_BLOCK + 1);                 // Too large for the pool, but still counted
+    size_t heap = pool_heap_allocations();
+    pool_free(block, POOL_MAX_BLOCK + 1);
+    block = pool_alloc(POOL_MAX_BLOCK + 1);
+    mu_assert("test_pool: Large block did not come from the heap", block != NULL && pool_heap_allocations() == heap + 1);
+    pool_free(block, POOL_MAX_BLOCK + 1);
+
+    channel_t* channels[CASES];
+    select_t list[CASES];
+    for (size_t i = 0; i < CASES; i++) {
+        channels[i] = (i % 3 == 0) ? channel_create(1) : (i % 3 == 1) ? channel_create(0) : channel_create_mpmc(1);
+        list[i] = (select_t) {channels[i], RECV, NULL};
+    }
+    list_t* nodes = list_create();
+    pthread_t pid;
+    struct timespec deadline;
+    size_t index = 0;
+    for (size_t pass = 0; pass < 2; pass++) {
+        size_t rounds = pass == 0 ? WARMUP : ROUNDS;
+        heap = pool_heap_allocations();
+
+        /* Selects that block (and so need scratch space for their waiters), woken by a partner */
+        select_partner_args args = {channels, CASES, rounds};
+        pthread_create(&pid, NULL, (void *)helper_select_partner, &args);
+        for (size_t round = 0; round < rounds; round++) {
+            mu_assert("test_pool: Select failed", channel_select(list, CASES, &index) == SUCCESS && list[index].data != NULL);
+        }
+        pthread_join(pid, NULL);
+
+        /* Selects that time out, and list nodes coming and going */
+        for (size_t round = 0; round < rounds / 10; round++) {
+            convertTimeToTimespec(getTime() + 100000, &deadline);
+            mu_assert("test_pool: Select should time out", channel_select_until(list, CASES, &index, &deadline) == TIMEOUT);
+        }
+        for (size_t round = 0; round < rounds; round++) {
+            list_insert(nodes, (void*)(round % 8 + 1));
+            if (list_count(nodes) == 8) {
+                while (list_begin(nodes)) {
+                    list_remove(nodes, list_begin(nodes));
+                }
+            }
+        }
+        if (pass == 1) {
+            mu_assert("test_pool: Steady state allocated from the heap", pool_heap_allocations() == heap);
+        }
+    }
+
+    /* Blocks cached by a thread that exits are not lost to the others */
+    pthread_create(&pid, NULL, helper_pool_churn, NULL);
+    pthread_join(pid, NULL);
+    heap = pool_heap_allocations();
+    list_t* more = list_create();
+    for (size_t i = 1; i <= 2 * POOL_CACHE_BLOCKS; i++) {
+        list_insert(more, (void*)i);
+    }
+    mu_assert("test_pool: Exited thread's blocks were not reused", pool_heap_allocations() <= heap + POOL_CACHE_BLOCKS);
+    list_destroy(more);
+    list_destroy(nodes);
+
+    for (size_t i = 0; i < CASES; i++) {
+        channel_close(channels[i]);
+        channel_destroy(channels[i]);
+    }
+    return NULL;
+}
+
+char* test_stats() {
+    print_test_details(__func__, "Testing the per-channel counters");
+    channel_t* channel = channel_create(2);
+    channel_stats_t stats;
+#if !CHANNEL_STATS
+    mu_assert("test_stats: Stats should be compiled out", channel_get_stats(channel, &stats) == GEN_ERROR && stats.sends == 0);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+#endif
+
+    /* Sends, receives, non-blocking failures and the high-water mark */
+    void* data = NULL;
+    mu_assert("test_stats: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_stats: Send failed", channel_non_blocking_send(channel, "Message2") == SUCCESS);
+    mu_assert("test_stats: Send should see a full channel", channel_non_blocking_send(channel, "Message3") == CHANNEL_FULL);
+    mu_assert("test_stats: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_stats: Receive failed", channel_non_blocking_receive(channel, &data) == SUCCESS);
+    mu_assert("test_stats: Receive should see an empty channel", channel_non_blocking_receive(channel, &data) == CHANNEL_EMPTY);
+    mu_assert("test_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_stats: Wrong message counts", stats.sends == 2 && stats.receives == 2);
+    mu_assert("test_stats: Wrong failure counts", stats.send_full == 1 && stats.receive_empty == 1);
+    mu_assert("test_stats: Wrong high-water mark", stats.high_water == 2);
+    mu_assert("test_stats: Nothing should have blocked", stats.blocked_sends == 0 && stats.blocked_receives == 0 && stats.blocked_ns == 0);
+
+    /* A receive that waits for its sender */
+    receive_args rargs;
+    pthread_t pid;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_stats: Send failed", channel_send(channel, "Message4") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_stats: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message4"));
+    mu_assert("test_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_stats: Wrong message counts", stats.sends == 3 && stats.receives == 3);
+    mu_assert("test_stats: Receive should have blocked", stats.blocked_receives == 1 && stats.blocked_sends == 0 && stats.blocked_ns > 0);
+    mu_assert("test_stats: Receiver was not woken", stats.wakeups >= 1 && stats.futile_wakeups < stats.wakeups);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    /* A select counts on the channel of the case it took, and a partner completing it notifies it */
+    channel = channel_create(0);
+    select_t list[] = {{channel, RECV, NULL}};
+    select_args sargs;
+    init_object_for_select_api(&sargs, list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &sargs);
+    usleep(10000);
+    mu_assert("test_stats: Send failed", channel_send(channel, "Message5") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_stats: Select failed", sargs.out == SUCCESS && string_equal(list[0].data, "Message5"));
+    mu_assert("test_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_stats: Wrong message counts", stats.sends == 1 && stats.receives == 1);
+    mu_assert("test_stats: Select was not notified", stats.select_notifications == 1);
+    mu_assert("test_stats: Unbuffered channels hold nothing", stats.high_water == 0);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    /* Lock-free channels sample their size every CHANNEL_STATS_SAMPLE sends, and once they fill up */
+    channel = channel_create_mpmc(2 * CHANNEL_STATS_SAMPLE);
+    for (size_t i = 0; i < CHANNEL_STATS_SAMPLE; i++) {
+        mu_assert("test_stats: Send failed", channel_send(channel, (void*)(i + 1)) == SUCCESS);
+    }
+    mu_assert("test_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_stats: Wrong sampled high-water mark", stats.sends == CHANNEL_STATS_SAMPLE && stats.high_water == CHANNEL_STATS_SAMPLE);
+    while (channel_non_blocking_send(channel, "Message6") == SUCCESS) {
+    }
+    mu_assert("test_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_stats: Full ring not counted", stats.send_full == 1 && stats.high_water == 2 * CHANNEL_STATS_SAMPLE);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    /* A lock-free receive counts as blocked once, however many times it parked */
+    channel = channel_create_mpmc(1);
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_stats: Send failed", channel_send(channel, "Message7") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_stats: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message7"));
+    mu_assert("test_stats: Get stats failed", channel_get_stats(channel, &stats) == SUCCESS);
+    mu_assert("test_stats: Lock-free receive should have blocked once", stats.blocked_receives == 1 && stats.blocked_ns > 0);
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+void* helper_trace(size_t* events) {
+    for (size_t i = 0; i < *events; i++) {
+        trace_record(TRACE_WAKE, events, (int32_t)i);
+    }
+    return NULL;
+}
+
+char* test_trace() {
+    print_test_details(__func__, "Testing the per-thread event rings and the trace file");
+    char path[] = "/tmp/channel_trace_XXXXXX";
+    int fd = mkstemp(path);
+    mu_assert("test_trace: Could not create a trace file", fd >= 0);
+    close(fd);
+
+    /* Every thread records into its own ring, which keeps the newest TRACE_RING_EVENTS events */
+    trace_start();
+    trace_record(TRACE_CLOSE, path, 7);
+    size_t events = TRACE_RING_EVENTS + 10;
+    pthread_t pid;
+    pthread_create(&pid, NULL, (void *)helper_trace, &events);
+    pthread_join(pid, NULL);
+
+    /* With CHANNEL_TRACE, a blocked receive shows up as park, unpark and receive on its thread */
+    channel_t* channel = channel_create(1);
+    receive_args rargs;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_trace: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_trace: Receive failed", rargs.out == SUCCESS);
+    trace_stop();
+    trace_record(TRACE_CLOSE, path, 8);                     // Not recorded any more
+    mu_assert("test_trace: Dump failed", trace_dump(path) == 0);
+
+    FILE* file = fopen(path, "rb");
+    mu_assert("test_trace: Could not open the trace file", file != NULL);
+    trace_header_t header;
+    mu_assert("test_trace: Short header", fread(&header, sizeof(header), 1, file) == 1);
+    mu_assert("test_trace: Bad header", memcmp(header.magic, TRACE_MAGIC, 8) == 0 && header.record_size == sizeof(trace_record_t));
+    bool found_main = false, found_helper = false, found_receiver = false;
+    for (uint32_t t = 0; t < header.thread_count; t++) {
+        trace_thread_t thread;
+        mu_assert("test_trace: Short thread", fread(&thread, sizeof(thread), 1, file) == 1);
+        trace_record_t records[TRACE_RING_EVENTS];
+        mu_assert("test_trace: Ring overflowed its size", thread.count <= TRACE_RING_EVENTS);
+        mu_assert("test_trace: Short records", fread(records, sizeof(trace_record_t), thread.count, file) == thread.count);
+        for (size_t i = 1; i < thread.count; i++) {
+            mu_assert("test_trace: Events out of order", records[i].ticks >= records[i - 1].ticks && records[i].ticks >= header.origin_ticks);
+        }
+        if (thread.count > 0 && records[0].event == TRACE_CLOSE && records[0].channel == (uintptr_t)path) {
+            found_main = true;                              // trace_start cleared whatever earlier tests left
+            mu_assert("test_trace: Event recorded after trace_stop", records[thread.count - 1].arg != 8);
+            mu_assert("test_trace: Send not traced", !CHANNEL_TRACE || (thread.count == 3 && records[1].event == TRACE_WAKE &&
+                                                                         records[2].event == TRACE_SEND && records[2].channel == (uintptr_t)channel));
+        } else if (thread.dropped == 10) {
+            found_helper = true;
+            mu_assert("test_trace: Ring should be full", thread.count == TRACE_RING_EVENTS);
+            for (size_t i = 0; i < thread.count; i++) {
+                mu_assert("test_trace: Ring lost the newest events", records[i].event == TRACE_WAKE && records[i].arg == (int32_t)(i + 10));
+            }
+        } else if (thread.count == 3) {
+            found_receiver = true;
+            mu_assert("test_trace: Wrong receive events", records[0].event == TRACE_PARK && records[0].arg == RECV &&
+                                                          records[1].event == TRACE_UNPARK && records[2].event == TRACE_RECEIVE &&
+                                                          records[2].channel == (uintptr_t)channel && records[2].arg == SUCCESS);
+        }
+    }
+    fclose(file);
+    unlink(path);
+    mu_assert("test_trace: Missing threads", found_main && found_helper && found_receiver == (CHANNEL_TRACE != 0));
+
+    /* trace_cleanup frees every ring; a thread that records again gets a new one */
+    trace_cleanup();
+    trace_start();
+    trace_record(TRACE_CLOSE, path, 9);
+    trace_stop();
+    mu_assert("test_trace: Dump failed", trace_dump(path) == 0);
+    file = fopen(path, "rb");
+    mu_assert("test_trace: Could not open the trace file", file != NULL);
+    mu_assert("test_trace: Short header", fread(&header, sizeof(header), 1, file) == 1);
+    fclose(file);
+    unlink(path);
+    mu_assert("test_trace: Freed rings were dumped", header.thread_count == 1);
+    trace_cleanup();
+
+    channel_close(channel);
+    channel_destroy(channel);
+    return NULL;
+}
+
+void* helper_detach_send(channel_t* channel) {
+    usleep(10000);
+    channel_attach_latency(channel, NULL);
+    channel_send(channel, "Message");
+    return NULL;
+}
+
+char* test_latency() {
+    print_test_details(__func__, "Testing latency histograms and attaching them to channels");
+
+    /* Percentiles come back within a bucket of the recorded values, and merging adds up counts */
+    histogram_t* a = histogram_create();
+    histogram_t* b = histogram_create();
+    mu_assert("test_latency: Empty histogram should report 0", histogram_count(a) == 0 && histogram_percentile(a, 99.0) == 0);
+    for (uint64_t v = 1; v <= 1000; v++) {
+        histogram_record(a, v);
+    }
+    uint64_t p50 = histogram_percentile(a, 50.0);
+    mu_assert("test_latency: Wrong count or max", histogram_count(a) == 1000 && histogram_max(a) == 1000);
+    mu_assert("test_latency: p50 out of its bucket", p50 >= 500 && p50 <= 500 + 500 / (1 << HISTOGRAM_SUB_BITS));
+    mu_assert("test_latency: p100 should be the max", histogram_percentile(a, 100.0) == 1000);
+    mu_assert("test_latency: Small values should be exact", histogram_percentile(a, 1.0) == 10);
+    histogram_record(b, UINT64_MAX);
+    histogram_merge(b, a);
+    mu_assert("test_latency: Merge lost counts", histogram_count(b) == 1001 && histogram_max(b) == UINT64_MAX);
+    mu_assert("test_latency: Merge moved the percentiles", histogram_percentile(b, 50.0) == p50);
+    histogram_reset(a);
+    mu_assert("test_latency: Reset left values", histogram_count(a) == 0 && histogram_max(a) == 0);
+    histogram_reset(b);
+
+    /* Messages buffered before the attach have no sojourn time; the ones after do */
+    histogram_t* sojourn = histogram_create();
+    histogram_t* select = histogram_create();
+    channel_latency_t latency = {sojourn, a, b, select};
+    channel_t* channel = channel_create(2);
+    void* data = NULL;
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message1") == SUCCESS);
+    mu_assert("test_latency: Attach failed", channel_attach_latency(channel, &latency) == SUCCESS);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message2") == SUCCESS);
+    mu_assert("test_latency: Send should see a full channel", channel_non_blocking_send(channel, "Message3") == CHANNEL_FULL);
+    mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message1"));
+    mu_assert("test_latency: Unstamped message recorded", histogram_count(sojourn) == 0);
+    mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS && string_equal(data, "Message2"));
+    mu_assert("test_latency: Sojourn not recorded", histogram_count(sojourn) == 1);
+    mu_assert("test_latency: Sends that did not wait should record 0", histogram_count(a) == 1 && histogram_max(a) == 0);
+    mu_assert("test_latency: Receives that did not wait should record 0", histogram_count(b) == 2 && histogram_max(b) == 0);
+
+    /* A receive that waits for its sender records the wait, and the message went straight to it */
+    receive_args rargs;
+    pthread_t pid;
+    init_object_for_receive_api(&rargs, channel, NULL);
+    pthread_create(&pid, NULL, (void *)helper_receive, &rargs);
+    usleep(10000);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message4") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_latency: Receive failed", rargs.out == SUCCESS && string_equal(rargs.data, "Message4"));
+    mu_assert("test_latency: Wait not recorded", histogram_count(b) == 3 && histogram_max(b) >= 5000000);
+    mu_assert("test_latency: Hand-off should have no sojourn", histogram_count(sojourn) == 2 && histogram_percentile(sojourn, 50.0) < 5000000);
+
+    /* A sender that waited for room counts its wait in the sojourn of its message */
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message5") == SUCCESS);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message6") == SUCCESS);
+    send_args sargs;
+    init_object_for_send_api(&sargs, channel, "Message7", NULL);
+    pthread_create(&pid, NULL, (void *)helper_send, &sargs);
+    usleep(10000);
+    for (int i = 5; i <= 7; i++) {
+        mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    }
+    pthread_join(pid, NULL);
+    mu_assert("test_latency: Wrong message", sargs.out == SUCCESS && string_equal(data, "Message7"));
+    mu_assert("test_latency: Sender's wait not in its sojourn", histogram_count(sojourn) == 5 && histogram_max(sojourn) >= 5000000);
+    mu_assert("test_latency: Send wait not recorded", histogram_max(a) >= 5000000);
+
+    /* Detached histograms record nothing more */
+    mu_assert("test_latency: Detach failed", channel_attach_latency(channel, NULL) == SUCCESS);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message8") == SUCCESS);
+    mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_latency: Detached histograms recorded", histogram_count(sojourn) == 5 && histogram_count(b) == 6);
+
+    /* A wait whose histogram was detached before it finished does not leak into the next receive */
+    mu_assert("test_latency: Attach failed", channel_attach_latency(channel, &latency) == SUCCESS);
+    pthread_create(&pid, NULL, (void *)helper_detach_send, channel);
+    mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    pthread_join(pid, NULL);
+    histogram_reset(b);
+    mu_assert("test_latency: Attach failed", channel_attach_latency(channel, &latency) == SUCCESS);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message8") == SUCCESS);
+    mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_latency: Earlier wait recorded by a later receive", histogram_count(b) == 1 && histogram_max(b) == 0);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    /* A select records its wait on the channel of the case it took */
+    channel = channel_create(0);
+    mu_assert("test_latency: Attach failed", channel_attach_latency(channel, &latency) == SUCCESS);
+    select_t list[] = {{channel, RECV, NULL}};
+    select_args selargs;
+    init_object_for_select_api(&selargs, list, 1, NULL);
+    pthread_create(&pid, NULL, (void *)helper_select, &selargs);
+    usleep(10000);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message9") == SUCCESS);
+    pthread_join(pid, NULL);
+    mu_assert("test_latency: Select failed", selargs.out == SUCCESS && string_equal(list[0].data, "Message9"));
+    mu_assert("test_latency: Select wait not recorded", histogram_count(select) == 1 && histogram_max(select) >= 5000000);
+    mu_assert("test_latency: Unbuffered hand-off not recorded", histogram_count(sojourn) == 7);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    /* Lock-free channels record waits but no sojourn times */
+    histogram_reset(a);
+    channel = channel_create_mpmc(2);
+    mu_assert("test_latency: Attach failed", channel_attach_latency(channel, &latency) == SUCCESS);
+    mu_assert("test_latency: Send failed", channel_send(channel, "Message10") == SUCCESS);
+    mu_assert("test_latency: Receive failed", channel_receive(channel, &data) == SUCCESS);
+    mu_assert("test_latency: Lock-free send not recorded", histogram_count(a) == 1);
+    mu_assert("test_latency: Lock-free channels have no sojourn times", histogram_count(sojourn) == 7);
+    channel_close(channel);
+    channel_destroy(channel);
+
+    histogram_free(a);
+    histogram_free(b);
+    histogram_free(sojourn);
+    histogram_free(select);
+    return NULL;
+}
+
 typedef char* (*test_fn_t)();
 typedef struct {
     char* name;
@@ -2053,18 +3755,41 @@ test_t tests[] = {{"test_initialization", test_initialization},
                   {"test_cpu_utilization_select", test_cpu_utilization_select},
                   {"test_cpu_utilization_overall", test_cpu_utilization_overall},
                   {"test_for_too_many_wakeups", test_for_too_many_wakeups},
-                  //{"test_unbuffered", test_unbuffered},
-                  //{"test_non_blocking_unbuffered", test_non_blocking_unbuffered},
-                  //{"test_stress_send_recv_unbuffered", test_stress_send_recv_unbuffered},
-                  //{"test_select_and_non_blocking_send_unbuffered", test_select_and_non_blocking_send_unbuffered},
-                  //{"test_select_and_non_blocking_receive_unbuffered", test_select_and_non_blocking_receive_unbuffered},
-                  //{"test_select_with_select_unbuffered", test_select_with_select_unbuffered},
-                  //{"test_select_with_same_channel_unbuffered", test_select_with_same_channel_unbuffered},
-                  //{"test_select_with_send_receive_on_same_channel_unbuffered", test_select_with_send_receive_on_same_channel_unbuffered},
-                  //{"test_select_with_duplicate_channel_unbuffered", test_select_with_duplicate_channel_unbuffered},
-                  //{"test_select_mixed_buffered_unbuffered", test_select_mixed_buffered_unbuffered},
-                  //{"test_stress_unbuffered", test_stress_unbuffered},
-                  //{"test_stress_mixed_buffered_unbuffered", test_stress_mixed_buffered_unbuffered},
+                  {"test_spsc", test_spsc},
+                  {"test_mpmc", test_mpmc},
+                  {"test_batch", test_batch},
+                  {"test_unbuffered", test_unbuffered},
+                  {"test_non_blocking_unbuffered", test_non_blocking_unbuffered},
+                  {"test_stress_send_recv_unbuffered", test_stress_send_recv_unbuffered},
+                  {"test_select_and_non_blocking_send_unbuffered", test_select_and_non_blocking_send_unbuffered},
+                  {"test_select_and_non_blocking_receive_unbuffered", test_select_and_non_blocking_receive_unbuffered},
+                  {"test_select_with_select_unbuffered", test_select_with_select_unbuffered},
+                  {"test_select_with_same_channel_unbuffered", test_select_with_same_channel_unbuffered},
+                  {"test_select_with_send_receive_on_same_channel_unbuffered", test_select_with_send_receive_on_same_channel_unbuffered},
+                  {"test_select_with_duplicate_channel_unbuffered", test_select_with_duplicate_channel_unbuffered},
+                  {"test_select_mixed_buffered_unbuffered", test_select_mixed_buffered_unbuffered},
+                  {"test_stress_unbuffered", test_stress_unbuffered},
+                  {"test_stress_mixed_buffered_unbuffered", test_stress_mixed_buffered_unbuffered},
+                  {"test_targeted_wakeups", test_targeted_wakeups},
+                  {"test_futex", test_futex},
+                  {"test_wait_policy", test_wait_policy},
+                  {"test_direct_handoff", test_direct_handoff},
+                  {"test_select_set", test_select_set},
+                  {"test_shared_subscribers", test_shared_subscribers},
+                  {"test_select_order", test_select_order},
+                  {"test_select_commit", test_select_commit},
+                  {"test_select_direction", test_select_direction},
+                  {"test_deadline", test_deadline},
+                  {"test_unbounded", test_unbounded},
+                  {"test_priority", test_priority},
+                  {"test_broadcast", test_broadcast},
+                  {"test_typed", test_typed},
+                  {"test_pow2_ring", test_pow2_ring},
+                  {"test_channel_array", test_channel_array},
+                  {"test_pool", test_pool},
+                  {"test_stats", test_stats},
+                  {"test_trace", test_trace},
+                  {"test_latency", test_latency},
 };
 
 size_t num_tests = sizeof(tests)/sizeof(tests[0]);
@@ -2098,6 +3823,7 @@ int main(int argc, char** argv) {
         }
 
         printf("Tests run: %d\n", tests_run);
+        pool_cleanup();                                     // Every test has joined its threads by now
  
         return result != NULL;
     } else if (argc == 3) {
@@ -2122,6 +3848,7 @@ int main(int argc, char** argv) {
     }
 
     printf("Tests run: %d\n", tests_run);
+    pool_cleanup();
 
     return result != NULL;
 }
@@ -0,0 +1,161 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// A thread's events; only the thread writes records and head, so recording needs no atomic RMW
+typedef struct trace_ring {
+    struct trace_ring* next;                                // Every ring ever created, newest first
+    uint32_t tid;
+    atomic_size_t head;                                     // Events recorded since trace_start; the last TRACE_RING_EVENTS are kept
+    trace_record_t records[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+static atomic_bool recording;
+static trace_ring_t* rings;                                 // Guarded by rings_mutex
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint generation;                              // Bumped by trace_cleanup, which frees every ring
+static __thread trace_ring_t* own_ring;
+static __thread unsigned int own_generation;                // own_ring is only valid while this matches generation
+static uint64_t origin_ticks;                               // trace_start's ticks and CLOCK_MONOTONIC time, to calibrate ticks against
+static uint64_t origin_ns;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+// The TSC where there is one (a few cycles to read), CLOCK_MONOTONIC nanoseconds elsewhere
+static uint64_t trace_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return monotonic_ns();
+#endif
+}
+
+// Allocates the calling thread's ring and links it into rings; it stays there after the thread
+// exits, so its events still make it into the next dump
+static trace_ring_t* ring_create(void)
+{
+    trace_ring_t* ring = calloc(1, sizeof(trace_ring_t));
+    if (!ring) {
+        return NULL;
+    }
+    ring->tid = (uint32_t) syscall(SYS_gettid);
+    atomic_init(&ring->head, 0);
+    pthread_mutex_lock(&rings_mutex);
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&rings_mutex);
+    own_ring = ring;
+    own_generation = atomic_load_explicit(&generation, memory_order_relaxed);
+    return ring;
+}
+
+// Clears every thread's ring and starts recording
+void trace_start(void)
+{
+    atomic_store(&recording, false);
+    pthread_mutex_lock(&rings_mutex);
+    for (trace_ring_t* ring = rings; ring; ring = ring->next) {
+        atomic_store(&ring->head, 0);
+    }
+    origin_ns = monotonic_ns();
+    origin_ticks = trace_ticks();
+    pthread_mutex_unlock(&rings_mutex);
+    atomic_store(&recording, true);
+}
+
+// Stops recording
+void trace_stop(void)
+{
+    atomic_store(&recording, false);
+}
+
+// Records an event for the calling thread, if recording
+void trace_record(enum trace_event event, const void* channel, int32_t arg)
+{
+    if (!atomic_load_explicit(&recording, memory_order_relaxed)) {
+        return;
+    }
+    trace_ring_t* ring = own_ring;
+    if (ring && own_generation != atomic_load_explicit(&generation, memory_order_relaxed)) {
+        ring = NULL;                                        // trace_cleanup freed it
+    }
+    if (!ring && !(ring = ring_create())) {
+        return;                                             // Out of memory: this thread goes untraced
+    }
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_record_t* record = &ring->records[head & (TRACE_RING_EVENTS - 1)];
+    record->ticks = trace_ticks();
+    record->channel = (uint64_t) (uintptr_t) channel;
+    record->event = (uint32_t) event;
+    record->arg = arg;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);   // The dump reads no further than head
+}
+
+// Writes every thread's events since trace_start to path
+// Returns 0 on success, and -1 if the file could not be written
+int trace_dump(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return -1;
+    }
+    pthread_mutex_lock(&rings_mutex);
+    trace_header_t header = {.record_size = sizeof(trace_record_t), .origin_ticks = origin_ticks, .ns_per_tick = 1.0};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    uint64_t ticks = trace_ticks() - origin_ticks;
+    uint64_t ns = monotonic_ns() - origin_ns;
+    if (ticks > 0 && ns > 0) {
+        header.ns_per_tick = (double) ns / (double) ticks;  // 1 without a TSC
+    }
+    for (trace_ring_t* ring = rings; ring; ring = ring->next) {
+        header.thread_count++;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (trace_ring_t* ring = rings; ring && ok; ring = ring->next) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        size_t count = head < TRACE_RING_EVENTS ? head : TRACE_RING_EVENTS;
+        size_t dropped = head - count;
+        trace_thread_t thread = {ring->tid, dropped > UINT32_MAX ? UINT32_MAX : (uint32_t) dropped, count};
+        ok = fwrite(&thread, sizeof(thread), 1, file) == 1;
+        for (size_t i = head - count; i < head && ok; i++) {   // Oldest first
+            ok = fwrite(&ring->records[i & (TRACE_RING_EVENTS - 1)], sizeof(trace_record_t), 1, file) == 1;
+        }
+    }
+    pthread_mutex_unlock(&rings_mutex);
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    return ok ? 0 : -1;
+}
+
+// Stops recording and frees every thread's ring
+void trace_cleanup(void)
+{
+    atomic_store(&recording, false);
+    pthread_mutex_lock(&rings_mutex);
+    while (rings) {
+        trace_ring_t* ring = rings;
+        rings = ring->next;
+        free(ring);
+    }
+    atomic_fetch_add(&generation, 1);                       // Every thread's own_ring is stale now
+    pthread_mutex_unlock(&rings_mutex);
+    own_ring = NULL;
+}
@@ -0,0 +1,80 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Binary event tracing of channel operations, for finding out which thread blocked on which channel
+// and for how long. Every thread records into a ring of its own, so recording takes no lock and
+// shares no cache line with other threads; a ring keeps the last TRACE_RING_EVENTS events of its thread.
+// Build with -DCHANNEL_TRACE=1 (make TRACE=1) to have the channel code record events; otherwise every
+// TRACE() in it compiles to nothing. trace2json.py turns a dumped trace into Chrome trace JSON.
+
+#ifndef CHANNEL_TRACE
+#define CHANNEL_TRACE 0
+#endif
+
+#define TRACE_RING_EVENTS 4096              // per thread; a power of two
+
+enum trace_event {
+    TRACE_SEND,         // a send finished; arg is its status
+    TRACE_RECEIVE,      // a receive finished; arg is its status
+    TRACE_SELECT,       // a select finished on channel (NULL if it timed out); arg is its status
+    TRACE_CLOSE,        // the channel was closed
+    TRACE_PARK,         // the thread starts waiting on channel; arg is the enum direction it waits to do
+                        // (channel is NULL and arg the number of cases for a select)
+    TRACE_UNPARK,       // the thread stops waiting; channel and arg as for TRACE_PARK
+    TRACE_WAKE,         // the thread woke a thread or select waiting on channel; arg is the status handed over
+};
+
+// One event, as recorded and as stored in a trace file
+typedef struct {
+    uint64_t ticks;     // timestamp; see trace_header_t for converting it to nanoseconds
+    uint64_t channel;   // address of the channel
+    uint32_t event;     // enum trace_event
+    int32_t arg;
+} trace_record_t;
+
+// A trace file is a trace_header_t, then for each of thread_count threads a trace_thread_t
+// followed by its events, oldest first; every field is in the byte order of the machine that dumped it
+#define TRACE_MAGIC "CHTRACE1"
+
+typedef struct {
+    char magic[8];              // TRACE_MAGIC, without its terminating NUL
+    uint32_t record_size;       // sizeof(trace_record_t)
+    uint32_t thread_count;
+    uint64_t origin_ticks;      // ticks at trace_start
+    double ns_per_tick;         // nanoseconds since trace_start = (ticks - origin_ticks) * ns_per_tick
+} trace_header_t;
+
+typedef struct {
+    uint32_t tid;               // kernel thread id
+    uint32_t dropped;           // older events the ring overwrote (saturates)
+    uint64_t count;             // events that follow
+} trace_thread_t;
+
+// Clears every thread's ring and starts recording
+// Call it while no traced thread is in a channel operation
+void trace_start(void);
+
+// Stops recording; the rings keep what they recorded
+void trace_stop(void);
+
+// Writes what every thread recorded since trace_start to the file at path
+// Call it once the traced threads are done or stopped, or their newest events may be torn
+// Returns 0 on success, and -1 if the file could not be written
+int trace_dump(const char* path);
+
+// Records an event for the calling thread, if recording; a thread's first event allocates its ring
+void trace_record(enum trace_event event, const void* channel, int32_t arg);
+
+// Stops recording and frees every thread's ring, with what it recorded
+// Call it while no traced thread is in a channel operation; a thread that records again later gets a new ring
+void trace_cleanup(void);
+
+#if CHANNEL_TRACE
+#define TRACE(event, channel, arg) trace_record((event), (channel), (int32_t) (arg))
+#else
+#define TRACE(event, channel, arg) ((void) 0)
+#endif
+
+#endif // TRACE_H
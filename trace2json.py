@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+
+# Converts a trace written by trace_dump (see trace.h) into Chrome trace JSON,
+# for chrome://tracing or https://ui.perfetto.dev
+# Usage: ./trace2json.py trace.bin > trace.json
+
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("=8sIIQd")       # trace_header_t
+THREAD = struct.Struct("=IIQ")          # trace_thread_t
+RECORD = struct.Struct("=QQIi")         # trace_record_t
+
+EVENTS = ["send", "receive", "select", "close", "park", "unpark", "wake"]
+STATUS = {1: "SUCCESS", 0: "FULL/EMPTY", -1: "GEN_ERROR", -2: "CLOSED_ERROR", -3: "DESTROY_ERROR", -4: "TIMEOUT"}
+DIRECTION = ["send", "receive"]
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, record_size, thread_count, origin_ticks, ns_per_tick = HEADER.unpack_from(data, 0)
+    if magic != b"CHTRACE1" or record_size != RECORD.size:
+        raise ValueError("%s is not a channel trace" % path)
+    offset = HEADER.size
+    threads = []
+    for _ in range(thread_count):
+        tid, dropped, count = THREAD.unpack_from(data, offset)
+        offset += THREAD.size
+        records = [RECORD.unpack_from(data, offset + i * RECORD.size) for i in range(count)]
+        offset += count * RECORD.size
+        threads.append((tid, dropped, records))
+    return origin_ticks, ns_per_tick, threads
+
+
+def to_chrome(origin_ticks, ns_per_tick, threads):
+    events = []
+    for tid, dropped, records in threads:
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid,
+                       "args": {"name": "thread %d (%d events dropped)" % (tid, dropped) if dropped else "thread %d" % tid}})
+        for ticks, channel, event, arg in records:
+            name = EVENTS[event] if event < len(EVENTS) else "event %d" % event
+            entry = {"pid": 1, "tid": tid, "ts": (ticks - origin_ticks) * ns_per_tick / 1000.0,
+                     "args": {"channel": "0x%x" % channel}}
+            if name in ("park", "unpark"):
+                entry["name"] = "wait to %s" % DIRECTION[arg] if channel and 0 <= arg < len(DIRECTION) else "select"
+                entry["ph"] = "B" if name == "park" else "E"
+            else:
+                entry["name"] = name
+                entry["ph"] = "i"
+                entry["s"] = "t"
+                if name in ("send", "receive", "select"):
+                    entry["args"]["status"] = STATUS.get(arg, arg)
+            events.append(entry)
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.exit("usage: %s trace.bin > trace.json" % sys.argv[0])
+    json.dump(to_chrome(*read_trace(sys.argv[1])), sys.stdout)
+    sys.stdout.write("\n")